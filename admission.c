@@ -0,0 +1,331 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "admission.h"
+#include "list.h"
+
+/* Waiting requests are retried at least this often, in ms */
+#define RETRY_INTERVAL		50
+
+struct admission_node {
+	struct list_head node;
+
+	unsigned int id;
+	unsigned int sessions;
+
+	/* Token bucket, in thousandths of a request */
+	unsigned long tokens;
+	struct timespec refilled;
+};
+
+struct admission_request {
+	struct list_head node;
+
+	struct sockaddr_qrtr sq;
+	struct timespec queued;
+
+	size_t len;
+	char req[];
+};
+
+static struct admission_limits limits;
+
+static struct list_head nodes = LIST_INIT(nodes);
+static size_t decompressed;
+
+static struct list_head queue = LIST_INIT(queue);
+static unsigned int queued;
+
+/* Set when a transfer ended, so that waiting requests are retried */
+static bool released;
+static struct timespec last_retry;
+
+static long elapsed_ms(const struct timespec *since)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - since->tv_sec) * 1000 +
+	       (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+static struct admission_node *admission_node_get(unsigned int id)
+{
+	struct admission_node *an;
+
+	list_for_each_entry(an, &nodes, node) {
+		if (an->id == id)
+			return an;
+	}
+
+	an = calloc(1, sizeof(*an));
+	if (!an)
+		return NULL;
+
+	an->id = id;
+	an->tokens = limits.rate * 1000UL;
+	clock_gettime(CLOCK_MONOTONIC, &an->refilled);
+	list_add(&nodes, &an->node);
+
+	return an;
+}
+
+/* Refill the bucket of @an, holding at most a second worth of requests */
+static void admission_refill(struct admission_node *an)
+{
+	unsigned long burst = limits.rate * 1000UL;
+	long elapsed;
+
+	elapsed = elapsed_ms(&an->refilled);
+	if (elapsed <= 0)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &an->refilled);
+	an->tokens += elapsed * limits.rate;
+	if (an->tokens > burst)
+		an->tokens = burst;
+}
+
+/**
+ * admission_init() - limit what remotes may request
+ * @new_limits:	limits to enforce, zeroes for none
+ */
+void admission_init(const struct admission_limits *new_limits)
+{
+	limits = *new_limits;
+}
+
+/**
+ * admission_begin() - admit a new transfer from a node
+ * @node:	node requesting the transfer
+ *
+ * Admitted transfers are to be ended by admission_end().
+ *
+ * Return: 0 if admitted, -EAGAIN if the node is over its limits
+ */
+int admission_begin(unsigned int node)
+{
+	struct admission_node *an;
+
+	if (!limits.sessions && !limits.rate)
+		return 0;
+
+	an = admission_node_get(node);
+	if (!an)
+		return -EAGAIN;
+
+	if (limits.sessions && an->sessions >= limits.sessions)
+		return -EAGAIN;
+
+	if (limits.rate) {
+		admission_refill(an);
+		if (an->tokens < 1000)
+			return -EAGAIN;
+		an->tokens -= 1000;
+	}
+
+	an->sessions++;
+
+	return 0;
+}
+
+/**
+ * admission_charge() - account a decompressed copy held by a transfer
+ * @bytes:	size of the decompressed copy
+ *
+ * Return: 0 if accounted, -EAGAIN if it would exceed the limit
+ */
+int admission_charge(size_t bytes)
+{
+	/* A copy larger than the limit is let through when it's the only one */
+	if (limits.decompressed && decompressed &&
+	    decompressed + bytes > limits.decompressed)
+		return -EAGAIN;
+
+	decompressed += bytes;
+
+	return 0;
+}
+
+/**
+ * admission_abort() - a transfer admitted by admission_begin() didn't start
+ * @node:	node of the transfer
+ * @bytes:	as passed to admission_charge(), 0 if not charged
+ *
+ * Unlike admission_end(), the node gets its rate token back, as the request
+ * is to be deferred and admitted again later.
+ */
+void admission_abort(unsigned int node, size_t bytes)
+{
+	unsigned long burst = limits.rate * 1000UL;
+	struct admission_node *an;
+
+	decompressed -= bytes;
+
+	list_for_each_entry(an, &nodes, node) {
+		if (an->id == node) {
+			if (an->sessions)
+				an->sessions--;
+			an->tokens += 1000;
+			if (an->tokens > burst)
+				an->tokens = burst;
+			break;
+		}
+	}
+}
+
+/**
+ * admission_adopt() - account a transfer regardless of the limits
+ * @node:	node of the transfer
+ * @bytes:	size of the decompressed copy held by the transfer, if any
+ *
+ * Used for transfers taken over from another process, already admitted there.
+ */
+void admission_adopt(unsigned int node, size_t bytes)
+{
+	struct admission_node *an;
+
+	decompressed += bytes;
+
+	if (!limits.sessions && !limits.rate)
+		return;
+
+	an = admission_node_get(node);
+	if (an)
+		an->sessions++;
+}
+
+/**
+ * admission_end() - a transfer admitted by admission_begin() ended
+ * @node:	node of the transfer
+ * @bytes:	as passed to admission_charge(), 0 if not charged
+ */
+void admission_end(unsigned int node, size_t bytes)
+{
+	struct admission_node *an;
+
+	decompressed -= bytes;
+	released = true;
+
+	list_for_each_entry(an, &nodes, node) {
+		if (an->id == node) {
+			if (an->sessions)
+				an->sessions--;
+			break;
+		}
+	}
+}
+
+/**
+ * admission_defer() - keep a request that wasn't admitted, to retry it later
+ * @req:	request, as parsed, passed back as is to the retry function
+ * @len:	length of @req
+ * @sq:		address of the remote
+ *
+ * Return: 0 if the request was queued, -1 if it should be rejected
+ */
+int admission_defer(const void *req, size_t len, const struct sockaddr_qrtr *sq)
+{
+	struct admission_request *deferred;
+
+	if (!limits.wait || queued >= ADMISSION_QUEUE_MAX)
+		return -1;
+
+	deferred = malloc(sizeof(*deferred) + len);
+	if (!deferred)
+		return -1;
+
+	deferred->sq = *sq;
+	deferred->len = len;
+	memcpy(deferred->req, req, len);
+	clock_gettime(CLOCK_MONOTONIC, &deferred->queued);
+
+	list_add(&queue, &deferred->node);
+	queued++;
+
+	return 0;
+}
+
+/**
+ * admission_timeout() - time until admission_tick() needs to be called
+ *
+ * Return: timeout in ms, -1 if none is needed
+ */
+int admission_timeout(void)
+{
+	struct admission_request *req;
+	long remaining;
+
+	if (list_empty(&queue))
+		return -1;
+
+	if (released)
+		return 0;
+
+	/* The oldest request is the first to expire */
+	req = list_entry_first(&queue, struct admission_request, node);
+	remaining = limits.wait - elapsed_ms(&req->queued);
+	if (remaining > RETRY_INTERVAL - elapsed_ms(&last_retry))
+		remaining = RETRY_INTERVAL - elapsed_ms(&last_retry);
+
+	return remaining > 0 ? remaining : 0;
+}
+
+/**
+ * admission_tick() - retry waiting requests, and reject the expired ones
+ * @retry:	called to handle a request again
+ * @reject:	called for each request that waited for too long
+ */
+void admission_tick(admission_retry_fn retry, admission_reject_fn reject)
+{
+	struct admission_request *req;
+	struct admission_request *next;
+	bool retrying;
+
+	if (list_empty(&queue))
+		return;
+
+	retrying = released || elapsed_ms(&last_retry) >= RETRY_INTERVAL;
+	if (retrying)
+		clock_gettime(CLOCK_MONOTONIC, &last_retry);
+
+	list_for_each_entry_safe(req, next, &queue, node) {
+		if (elapsed_ms(&req->queued) >= limits.wait)
+			reject(&req->sq);
+		else if (!retrying || retry(req->req, req->len, &req->sq) == -EAGAIN)
+			continue;
+
+		list_del(&req->node);
+		queued--;
+		free(req);
+	}
+
+	/* Retried requests failing after admission don't count as releases */
+	if (retrying)
+		released = false;
+}
+
+/**
+ * admission_flush() - reject all waiting requests
+ * @reject:	called for each request
+ */
+void admission_flush(admission_reject_fn reject)
+{
+	struct admission_request *req;
+	struct admission_request *next;
+
+	list_for_each_entry_safe(req, next, &queue, node) {
+		reject(&req->sq);
+		list_del(&req->node);
+		free(req);
+	}
+	queued = 0;
+}
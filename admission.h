@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __ADMISSION_H__
+#define __ADMISSION_H__
+
+#include <sys/types.h>
+#include <libqrtr.h>
+
+/* Requests waiting for admission, across all nodes */
+#define ADMISSION_QUEUE_MAX	32
+
+struct admission_limits {
+	/* Concurrent transfers per node, 0 for no limit */
+	unsigned int sessions;
+
+	/* Bytes of decompressed copies held by transfers, 0 for no limit */
+	size_t decompressed;
+
+	/* Requests admitted per second and node, 0 for no limit */
+	unsigned int rate;
+
+	/* How long, in ms, a request may wait for admission; 0 to reject */
+	unsigned int wait;
+};
+
+/* Handles a request again, returns -EAGAIN if it's still not admitted */
+typedef int (*admission_retry_fn)(const void *req, size_t len,
+				  struct sockaddr_qrtr *sq);
+/* Rejects a request that waited for too long */
+typedef void (*admission_reject_fn)(struct sockaddr_qrtr *sq);
+
+void admission_init(const struct admission_limits *limits);
+int admission_begin(unsigned int node);
+int admission_charge(size_t bytes);
+void admission_abort(unsigned int node, size_t bytes);
+void admission_adopt(unsigned int node, size_t bytes);
+void admission_end(unsigned int node, size_t bytes);
+int admission_defer(const void *req, size_t len, const struct sockaddr_qrtr *sq);
+int admission_timeout(void);
+void admission_tick(admission_retry_fn retry, admission_reject_fn reject);
+void admission_flush(admission_reject_fn reject);
+
+#endif
@@ -0,0 +1,318 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zstd.h>
+
+#include "blockcache.h"
+#include "membudget.h"
+
+/*
+ * Fast, negative, compression level. Decompression speed is what matters, as
+ * it happens for every block sent, and these levels trade ratio for speed.
+ */
+#define BLOCKCACHE_LEVEL	-3
+
+/* A file held in memory as individually compressed chunks */
+struct blockcache_file {
+	atomic_int refcount;
+
+	size_t size;
+	size_t nchunks;
+
+	/* Chunk i is stored at data + offsets[i], up to offsets[i + 1] */
+	size_t *offsets;
+	char *data;
+
+	/* Set when data is the uncompressed file, owned by someone else */
+	bool raw;
+};
+
+static ZSTD_CCtx *cctx;
+static pthread_mutex_t cctx_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Chunks are only ever decompressed from the main thread */
+static ZSTD_DCtx *dctx;
+
+static size_t chunk_len(const struct blockcache_file *bf, size_t chunk)
+{
+	if (chunk == bf->nchunks - 1 && bf->size % BLOCKCACHE_CHUNK)
+		return bf->size % BLOCKCACHE_CHUNK;
+
+	return BLOCKCACHE_CHUNK;
+}
+
+/**
+ * blockcache_create() - build a compressed in-memory copy of a file
+ * @fd:		file to copy
+ *
+ * Chunks which don't shrink are stored as is.
+ *
+ * Return: new object, with one reference held, on success; NULL on error
+ */
+struct blockcache_file *blockcache_create(int fd)
+{
+	struct blockcache_file *bf;
+	size_t bound;
+	size_t used = 0;
+	size_t len;
+	size_t n;
+	size_t i;
+	struct stat sb;
+	char *src;
+	char *tmp;
+
+	if (fstat(fd, &sb) < 0 || !sb.st_size)
+		return NULL;
+
+	src = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (src == MAP_FAILED)
+		return NULL;
+
+	bf = calloc(1, sizeof(*bf));
+	if (!bf)
+		goto err_unmap;
+
+	bf->size = sb.st_size;
+	bf->nchunks = (bf->size + BLOCKCACHE_CHUNK - 1) / BLOCKCACHE_CHUNK;
+	bf->offsets = calloc(bf->nchunks + 1, sizeof(*bf->offsets));
+	bound = ZSTD_compressBound(BLOCKCACHE_CHUNK);
+	bf->data = malloc(bf->nchunks * bound);
+	if (!bf->offsets || !bf->data)
+		goto err_free;
+
+	pthread_mutex_lock(&cctx_lock);
+	if (!cctx)
+		cctx = ZSTD_createCCtx();
+
+	for (i = 0; i < bf->nchunks; i++) {
+		len = chunk_len(bf, i);
+
+		n = ZSTD_compressCCtx(cctx, bf->data + used, bound,
+				      src + i * BLOCKCACHE_CHUNK, len,
+				      BLOCKCACHE_LEVEL);
+		if (ZSTD_isError(n) || n >= len) {
+			memcpy(bf->data + used, src + i * BLOCKCACHE_CHUNK, len);
+			n = len;
+		}
+
+		bf->offsets[i] = used;
+		used += n;
+	}
+	bf->offsets[i] = used;
+	pthread_mutex_unlock(&cctx_lock);
+
+	tmp = realloc(bf->data, used);
+	if (tmp)
+		bf->data = tmp;
+
+	munmap(src, sb.st_size);
+
+	atomic_init(&bf->refcount, 1);
+
+	return bf;
+
+err_free:
+	free(bf->offsets);
+	free(bf->data);
+	free(bf);
+err_unmap:
+	munmap(src, sb.st_size);
+	return NULL;
+}
+
+/**
+ * blockcache_wrap() - present uncompressed memory as an in-memory file
+ * @data:	content of the file, which must outlive the returned object
+ * @size:	size of the file
+ *
+ * Used for content held in memory shared with other processes, so that it's
+ * read the same way as compressed copies.
+ *
+ * Return: new object, with one reference held, on success; NULL on error
+ */
+struct blockcache_file *blockcache_wrap(const void *data, size_t size)
+{
+	struct blockcache_file *bf;
+
+	bf = calloc(1, sizeof(*bf));
+	if (!bf)
+		return NULL;
+
+	bf->size = size;
+	bf->data = (char *)data;
+	bf->raw = true;
+
+	atomic_init(&bf->refcount, 1);
+
+	return bf;
+}
+
+struct blockcache_file *blockcache_get(struct blockcache_file *bf)
+{
+	atomic_fetch_add_explicit(&bf->refcount, 1, memory_order_relaxed);
+
+	return bf;
+}
+
+void blockcache_put(struct blockcache_file *bf)
+{
+	if (atomic_fetch_sub_explicit(&bf->refcount, 1, memory_order_acq_rel) != 1)
+		return;
+
+	free(bf->offsets);
+	if (!bf->raw)
+		free(bf->data);
+	free(bf);
+}
+
+/**
+ * blockcache_size() - size of the file, as uncompressed
+ */
+size_t blockcache_size(const struct blockcache_file *bf)
+{
+	return bf->size;
+}
+
+/**
+ * blockcache_footprint() - number of bytes of memory held by the object
+ */
+size_t blockcache_footprint(const struct blockcache_file *bf)
+{
+	if (bf->raw)
+		return sizeof(*bf);
+
+	return sizeof(*bf) + (bf->nchunks + 1) * sizeof(*bf->offsets) +
+	       bf->offsets[bf->nchunks];
+}
+
+/**
+ * blockcache_read() - read from a compressed in-memory file
+ * @bf:		file to read from
+ * @cursor:	per-reader state, holding the last decompressed chunk
+ * @buf:	buffer to read into
+ * @len:	number of bytes to read
+ * @offset:	offset in the file to read from
+ *
+ * Only the chunks covering the requested range are decompressed, and as
+ * requests are typically sequential and much smaller than a chunk the last
+ * decompressed chunk is kept in @cursor for the following reads.
+ *
+ * Return: number of bytes read, -1 on error
+ */
+ssize_t blockcache_read(struct blockcache_file *bf,
+			struct blockcache_cursor *cursor,
+			void *buf, size_t len, off_t offset)
+{
+	size_t chunk_offset;
+	size_t chunk;
+	size_t stored;
+	size_t copied = 0;
+	size_t clen;
+	size_t n;
+	char *p = buf;
+
+	if (offset >= bf->size)
+		return 0;
+
+	if (len > bf->size - offset)
+		len = bf->size - offset;
+
+	if (bf->raw) {
+		memcpy(buf, bf->data + offset, len);
+		return len;
+	}
+
+	if (!cursor->buf) {
+		cursor->buf = malloc(BLOCKCACHE_CHUNK);
+		if (!cursor->buf)
+			return -1;
+		cursor->chunk = SIZE_MAX;
+		membudget_account(MEMBUDGET_TRANSFERS, BLOCKCACHE_CHUNK);
+	}
+
+	if (!dctx)
+		dctx = ZSTD_createDCtx();
+
+	while (copied < len) {
+		chunk = (offset + copied) / BLOCKCACHE_CHUNK;
+		chunk_offset = (offset + copied) % BLOCKCACHE_CHUNK;
+		clen = chunk_len(bf, chunk);
+
+		if (cursor->chunk != chunk) {
+			stored = bf->offsets[chunk + 1] - bf->offsets[chunk];
+			if (stored == clen) {
+				memcpy(cursor->buf, bf->data + bf->offsets[chunk], clen);
+			} else {
+				n = ZSTD_decompressDCtx(dctx, cursor->buf, clen,
+							bf->data + bf->offsets[chunk],
+							stored);
+				if (ZSTD_isError(n) || n != clen) {
+					cursor->chunk = SIZE_MAX;
+					return -1;
+				}
+			}
+			cursor->chunk = chunk;
+		}
+
+		n = clen - chunk_offset;
+		if (n > len - copied)
+			n = len - copied;
+
+		memcpy(p + copied, cursor->buf + chunk_offset, n);
+		copied += n;
+	}
+
+	return copied;
+}
+
+/**
+ * blockcache_cursor_init() - allocate the state of a reader up front
+ * @bf:		file to be read
+ * @cursor:	per-reader state to set up
+ *
+ * Otherwise allocated on the first read, this keeps allocations off the
+ * packet path.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int blockcache_cursor_init(struct blockcache_file *bf,
+			   struct blockcache_cursor *cursor)
+{
+	if (bf->raw || cursor->buf)
+		return 0;
+
+	if (!dctx)
+		dctx = ZSTD_createDCtx();
+	if (!dctx)
+		return -1;
+
+	cursor->buf = malloc(BLOCKCACHE_CHUNK);
+	if (!cursor->buf)
+		return -1;
+	cursor->chunk = SIZE_MAX;
+	membudget_account(MEMBUDGET_TRANSFERS, BLOCKCACHE_CHUNK);
+
+	return 0;
+}
+
+/**
+ * blockcache_cursor_release() - free the state held by a reader
+ */
+void blockcache_cursor_release(struct blockcache_cursor *cursor)
+{
+	if (cursor->buf)
+		membudget_account(MEMBUDGET_TRANSFERS, -BLOCKCACHE_CHUNK);
+	free(cursor->buf);
+	cursor->buf = NULL;
+}
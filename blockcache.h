@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __BLOCKCACHE_H__
+#define __BLOCKCACHE_H__
+
+#include <sys/types.h>
+
+#include "profile.h"
+
+#define BLOCKCACHE_CHUNK	(64 * 1024)
+
+struct blockcache_file;
+
+struct blockcache_cursor {
+	char *buf;
+	size_t chunk;
+};
+
+#if TQFTP_WITH_CACHE
+struct blockcache_file *blockcache_create(int fd);
+struct blockcache_file *blockcache_wrap(const void *data, size_t size);
+struct blockcache_file *blockcache_get(struct blockcache_file *bf);
+void blockcache_put(struct blockcache_file *bf);
+size_t blockcache_size(const struct blockcache_file *bf);
+size_t blockcache_footprint(const struct blockcache_file *bf);
+ssize_t blockcache_read(struct blockcache_file *bf,
+			struct blockcache_cursor *cursor,
+			void *buf, size_t len, off_t offset);
+int blockcache_cursor_init(struct blockcache_file *bf,
+			   struct blockcache_cursor *cursor);
+void blockcache_cursor_release(struct blockcache_cursor *cursor);
+#else
+static inline void blockcache_put(struct blockcache_file *bf) {}
+static inline size_t blockcache_size(const struct blockcache_file *bf) { return 0; }
+static inline ssize_t blockcache_read(struct blockcache_file *bf,
+				      struct blockcache_cursor *cursor,
+				      void *buf, size_t len, off_t offset) { return -1; }
+static inline int blockcache_cursor_init(struct blockcache_file *bf,
+					 struct blockcache_cursor *cursor) { return -1; }
+static inline void blockcache_cursor_release(struct blockcache_cursor *cursor) {}
+#endif
+
+#endif
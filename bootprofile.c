@@ -0,0 +1,299 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include <sys/stat.h>
+#include <err.h>
+#include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bootprofile.h"
+#include "list.h"
+#include "prefetch.h"
+
+#ifndef ANDROID
+#define BOOTPROFILE_PATH	"/var/lib/tqftpserv/boot.profile"
+#else
+#define BOOTPROFILE_PATH	"/data/vendor/tqftpserv/boot.profile"
+#endif
+
+/* Requests this long, in ms, after the first one are not part of the boot */
+#define BOOTPROFILE_WINDOW	30000
+#define BOOTPROFILE_MAX_ENTRIES	256
+
+struct bootprofile_entry {
+	struct list_head node;
+
+	unsigned int node_id;
+	off_t seek;
+	size_t rsize;
+	unsigned int delay_ms;
+	char *path;
+};
+
+/* Requests recorded since a remote came up */
+struct bootprofile_session {
+	struct list_head node;
+
+	unsigned int node_id;
+	struct timespec start;
+	unsigned int count;
+	bool done;
+
+	struct list_head entries;
+};
+
+/* Boot sequence of all remotes, as last recorded */
+static struct list_head profile = LIST_INIT(profile);
+static struct list_head sessions = LIST_INIT(sessions);
+
+static bool bootprofile_enabled;
+
+static unsigned int elapsed_ms(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1000 +
+	       (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+static void entry_free(struct bootprofile_entry *entry)
+{
+	list_del(&entry->node);
+	free(entry->path);
+	free(entry);
+}
+
+/* Insert @entry into @list, keeping it sorted by delay */
+static void entry_insert_sorted(struct list_head *list,
+				struct bootprofile_entry *entry)
+{
+	struct bootprofile_entry *pos;
+
+	list_for_each_entry(pos, list, node) {
+		if (pos->delay_ms > entry->delay_ms) {
+			list_add(&pos->node, &entry->node);
+			return;
+		}
+	}
+
+	list_add(list, &entry->node);
+}
+
+static void bootprofile_save(void)
+{
+	struct bootprofile_entry *entry;
+	char tmp[PATH_MAX];
+	char *dir;
+	FILE *f;
+
+	dir = strdup(BOOTPROFILE_PATH);
+	mkdir(dirname(dir), 0700);
+	free(dir);
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", BOOTPROFILE_PATH);
+	f = fopen(tmp, "w");
+	if (!f) {
+		warn("failed to save boot profile");
+		return;
+	}
+
+	list_for_each_entry(entry, &profile, node) {
+		fprintf(f, "%u %lld %zu %u %s\n", entry->node_id,
+			(long long)entry->seek, entry->rsize, entry->delay_ms,
+			entry->path);
+	}
+
+	if (fflush(f) || fsync(fileno(f)) || fclose(f) ||
+	    rename(tmp, BOOTPROFILE_PATH) < 0) {
+		warn("failed to save boot profile");
+		unlink(tmp);
+	}
+}
+
+static void bootprofile_load(void)
+{
+	struct bootprofile_entry *entry;
+	char path[PATH_MAX];
+	unsigned int node_id;
+	unsigned int delay_ms;
+	long long seek;
+	size_t rsize;
+	char fmt[32];
+	FILE *f;
+
+	f = fopen(BOOTPROFILE_PATH, "r");
+	if (!f)
+		return;
+
+	snprintf(fmt, sizeof(fmt), "%%u %%lld %%zu %%u %%%ds", PATH_MAX - 1);
+	while (fscanf(f, fmt, &node_id, &seek, &rsize, &delay_ms, path) == 5) {
+		entry = calloc(1, sizeof(*entry));
+		if (!entry)
+			break;
+
+		entry->node_id = node_id;
+		entry->seek = seek;
+		entry->rsize = rsize;
+		entry->delay_ms = delay_ms;
+		entry->path = strdup(path);
+		entry_insert_sorted(&profile, entry);
+	}
+
+	fclose(f);
+}
+
+/* Replace the recorded boot sequence of the remote with that of @session */
+static void bootprofile_complete(struct bootprofile_session *session)
+{
+	struct bootprofile_entry *entry;
+	struct bootprofile_entry *next;
+
+	session->done = true;
+	if (list_empty(&session->entries))
+		return;
+
+	list_for_each_entry_safe(entry, next, &profile, node) {
+		if (entry->node_id == session->node_id)
+			entry_free(entry);
+	}
+
+	list_for_each_entry_safe(entry, next, &session->entries, node) {
+		list_del(&entry->node);
+		entry_insert_sorted(&profile, entry);
+	}
+
+	bootprofile_save();
+}
+
+/**
+ * bootprofile_init() - load the boot profile and prefetch its files
+ *
+ * Return: 0 on success, -1 on error
+ */
+int bootprofile_init(void)
+{
+	struct bootprofile_entry *entry;
+
+	if (prefetch_init() < 0)
+		return -1;
+
+	bootprofile_enabled = true;
+	bootprofile_load();
+
+	list_for_each_entry(entry, &profile, node)
+		prefetch_queue(entry->path, entry->seek, entry->rsize);
+
+	return 0;
+}
+
+/**
+ * bootprofile_prefetch() - prefetch the files of a remote's boot sequence
+ * @node_id:	qrtr node of the remote
+ */
+void bootprofile_prefetch(unsigned int node_id)
+{
+	struct bootprofile_entry *entry;
+
+	if (!bootprofile_enabled)
+		return;
+
+	list_for_each_entry(entry, &profile, node) {
+		if (entry->node_id == node_id)
+			prefetch_queue(entry->path, entry->seek, entry->rsize);
+	}
+}
+
+/**
+ * bootprofile_record() - record a read request as part of a boot sequence
+ * @node_id:	qrtr node of the remote
+ * @path:	path, as requested by the remote
+ * @seek:	offset requested
+ * @rsize:	size requested, 0 for the entire file
+ *
+ * The first request from a remote starts recording its boot sequence. The
+ * sequence is saved for prefetching on the next start by the first request
+ * after BOOTPROFILE_WINDOW has passed, or when the remote goes away. A new
+ * sequence is not recorded until the remote goes away.
+ */
+void bootprofile_record(unsigned int node_id, const char *path, off_t seek,
+			size_t rsize)
+{
+	struct bootprofile_session *session;
+	struct bootprofile_entry *entry;
+	unsigned int delay_ms;
+
+	if (!bootprofile_enabled)
+		return;
+
+	list_for_each_entry(session, &sessions, node) {
+		if (session->node_id == node_id)
+			goto found;
+	}
+
+	session = calloc(1, sizeof(*session));
+	if (!session)
+		return;
+
+	session->node_id = node_id;
+	clock_gettime(CLOCK_MONOTONIC, &session->start);
+	list_init(&session->entries);
+	list_add(&sessions, &session->node);
+
+found:
+	if (session->done)
+		return;
+
+	delay_ms = elapsed_ms(&session->start);
+	if (delay_ms > BOOTPROFILE_WINDOW ||
+	    session->count >= BOOTPROFILE_MAX_ENTRIES) {
+		bootprofile_complete(session);
+		return;
+	}
+
+	entry = calloc(1, sizeof(*entry));
+	if (!entry)
+		return;
+
+	entry->node_id = node_id;
+	entry->seek = seek;
+	entry->rsize = rsize;
+	entry->delay_ms = delay_ms;
+	entry->path = strdup(path);
+	list_add(&session->entries, &entry->node);
+	session->count++;
+}
+
+/**
+ * bootprofile_reset() - the remote went away, prepare for its next boot
+ * @node_id:	qrtr node of the remote
+ */
+void bootprofile_reset(unsigned int node_id)
+{
+	struct bootprofile_session *session;
+	struct bootprofile_entry *entry;
+	struct bootprofile_entry *next;
+
+	list_for_each_entry(session, &sessions, node) {
+		if (session->node_id != node_id)
+			continue;
+
+		if (!session->done)
+			bootprofile_complete(session);
+
+		list_for_each_entry_safe(entry, next, &session->entries, node)
+			entry_free(entry);
+
+		list_del(&session->node);
+		free(session);
+		return;
+	}
+}
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __BOOTPROFILE_H__
+#define __BOOTPROFILE_H__
+
+#include <sys/types.h>
+
+#include "profile.h"
+
+#if TQFTP_WITH_CACHE
+int bootprofile_init(void);
+void bootprofile_prefetch(unsigned int node_id);
+void bootprofile_record(unsigned int node_id, const char *path, off_t seek,
+			size_t rsize);
+void bootprofile_reset(unsigned int node_id);
+#else
+static inline int bootprofile_init(void) { return -1; }
+static inline void bootprofile_prefetch(unsigned int node_id) {}
+static inline void bootprofile_record(unsigned int node_id, const char *path,
+				      off_t seek, size_t rsize) {}
+static inline void bootprofile_reset(unsigned int node_id) {}
+#endif
+
+#endif
@@ -0,0 +1,599 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+/* For F_GET_SEALS */
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "blockcache.h"
+#include "cache.h"
+#include "fdstore.h"
+#include "hash.h"
+#include "list.h"
+#include "membudget.h"
+#include "shmcache.h"
+
+/* Regular files larger than this are identified by inode, not content */
+#define DEDUP_MAX_PLAIN		(8 * 1024 * 1024)
+#define HASH_MEMO_MAX		256
+
+/*
+ * Content of a resolved, and possibly decompressed, file. Referred to either
+ * by an fd, or by a compressed in-memory copy, and shared by all paths which
+ * resolved to identical content.
+ */
+struct cache_object {
+	struct list_head node;
+
+	uint64_t hash;
+	bool by_inode;
+	size_t file_size;
+
+	int fd;
+	struct blockcache_file *blocks;
+	size_t size;
+
+	/* Id of @fd in the service manager's fd store, or 0 */
+	unsigned int stored;
+
+	unsigned int refs;
+};
+
+/* A path, as requested by the remote, resolved to @obj */
+struct cache_entry {
+	struct list_head node;
+
+	char *path;
+	struct cache_object *obj;
+
+	/* Never evicted to make room, see cache_pin() */
+	bool pinned;
+};
+
+/* Content hash of a regular file, so it's computed once per inode and mtime */
+struct hash_memo {
+	struct list_head node;
+
+	dev_t dev;
+	ino_t ino;
+	struct timespec mtime;
+	off_t size;
+	uint64_t hash;
+};
+
+/* Least recently used entries first */
+static struct list_head entries = LIST_INIT(entries);
+static struct list_head objects = LIST_INIT(objects);
+static struct list_head memos = LIST_INIT(memos);
+static unsigned int nmemos;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t cache_budget;
+static size_t cache_limit;
+static unsigned int cache_level;
+static bool cache_registered;
+static size_t cache_size;
+static bool cache_compress;
+
+static struct cache_entry *cache_find(const char *path)
+{
+	struct cache_entry *entry;
+
+	list_for_each_entry(entry, &entries, node) {
+		if (!strcmp(entry->path, path))
+			return entry;
+	}
+
+	return NULL;
+}
+
+static struct cache_object *object_find(uint64_t hash, bool by_inode,
+					size_t file_size)
+{
+	struct cache_object *obj;
+
+	list_for_each_entry(obj, &objects, node) {
+		if (obj->hash == hash && obj->by_inode == by_inode &&
+		    obj->file_size == file_size)
+			return obj;
+	}
+
+	return NULL;
+}
+
+static void object_free(struct cache_object *obj)
+{
+	if (obj->blocks)
+		blockcache_put(obj->blocks);
+	else
+		close(obj->fd);
+	free(obj);
+}
+
+static void cache_evict(struct cache_entry *entry)
+{
+	struct cache_object *obj = entry->obj;
+
+	list_del(&entry->node);
+	free(entry->path);
+	free(entry);
+
+	if (--obj->refs)
+		return;
+
+	list_del(&obj->node);
+	if (obj->stored)
+		fdstore_remove(obj->stored);
+	cache_size -= obj->size;
+	membudget_account(obj->blocks ? MEMBUDGET_CACHE_BLOCKS : MEMBUDGET_CACHE_FILES,
+			  -(ssize_t)obj->size);
+	object_free(obj);
+}
+
+/*
+ * Record which stored fd each path resolved to, so the cache can be rebuilt
+ * from the fd store after a restart.
+ */
+static void cache_save_index(void)
+{
+	struct cache_entry *entry;
+	char *buf = NULL;
+	size_t len = 0;
+	FILE *f;
+
+	if (!fdstore_active())
+		return;
+
+	f = open_memstream(&buf, &len);
+	if (!f)
+		return;
+
+	list_for_each_entry(entry, &entries, node) {
+		if (entry->obj->stored && !strchr(entry->path, '\n'))
+			fprintf(f, "%u %s\n", entry->obj->stored, entry->path);
+	}
+
+	if (!fclose(f))
+		fdstore_save_index(buf, len);
+	free(buf);
+}
+
+/* Least recently used entry that may be evicted, or NULL */
+static struct cache_entry *cache_lru(void)
+{
+	struct cache_entry *entry;
+
+	list_for_each_entry(entry, &entries, node) {
+		if (!entry->pinned)
+			return entry;
+	}
+
+	return NULL;
+}
+
+/* Evict the least recently used entries until below the current limit */
+static void cache_shrink(void)
+{
+	struct cache_entry *entry;
+
+	while (cache_size > cache_limit && (entry = cache_lru()))
+		cache_evict(entry);
+}
+
+/*
+ * Give back memory under pressure; prefetching is paused first, the cache
+ * halves for every level beyond that and grows back as pressure clears.
+ */
+static void cache_pressure(unsigned int level)
+{
+	pthread_mutex_lock(&cache_lock);
+	cache_level = level;
+	cache_limit = level < 2 ? cache_budget : cache_budget >> (level - 1);
+	cache_shrink();
+	cache_save_index();
+	pthread_mutex_unlock(&cache_lock);
+}
+
+static bool memo_lookup(const struct stat *sb, uint64_t *hash)
+{
+	struct hash_memo *memo;
+	bool found = false;
+
+	pthread_mutex_lock(&cache_lock);
+	list_for_each_entry(memo, &memos, node) {
+		if (memo->dev == sb->st_dev && memo->ino == sb->st_ino &&
+		    memo->size == sb->st_size &&
+		    memo->mtime.tv_sec == sb->st_mtim.tv_sec &&
+		    memo->mtime.tv_nsec == sb->st_mtim.tv_nsec) {
+			*hash = memo->hash;
+			found = true;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&cache_lock);
+
+	return found;
+}
+
+static void memo_add(const struct stat *sb, uint64_t hash)
+{
+	struct hash_memo *memo;
+
+	memo = calloc(1, sizeof(*memo));
+	if (!memo)
+		return;
+
+	memo->dev = sb->st_dev;
+	memo->ino = sb->st_ino;
+	memo->mtime = sb->st_mtim;
+	memo->size = sb->st_size;
+	memo->hash = hash;
+
+	pthread_mutex_lock(&cache_lock);
+	if (nmemos >= HASH_MEMO_MAX) {
+		struct hash_memo *oldest = list_entry_first(&memos, struct hash_memo, node);
+
+		list_del(&oldest->node);
+		free(oldest);
+		nmemos--;
+	}
+	list_add(&memos, &memo->node);
+	nmemos++;
+	pthread_mutex_unlock(&cache_lock);
+}
+
+/**
+ * content_hash() - identify the content of a resolved file
+ * @fd:		resolved file
+ * @sb:		stat of @fd
+ * @memfd:	@fd is a memfd, holding decompressed content
+ * @by_inode:	set if the returned value identifies the inode, not the content
+ *
+ * Decompressed content is always hashed, its decompression cost far exceeds
+ * that of hashing. Regular files are hashed once per inode and mtime, unless
+ * too large to hash on the request path; these are identified by inode.
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int content_hash(int fd, const struct stat *sb, bool memfd,
+			uint64_t *hash, bool *by_inode)
+{
+	struct {
+		dev_t dev;
+		ino_t ino;
+		struct timespec mtime;
+	} id = { sb->st_dev, sb->st_ino, sb->st_mtim };
+	void *data;
+
+	*by_inode = false;
+
+	if (!memfd && sb->st_size > DEDUP_MAX_PLAIN) {
+		*by_inode = true;
+		*hash = hash64(&id, sizeof(id));
+		return 0;
+	}
+
+	if (!memfd && memo_lookup(sb, hash))
+		return 0;
+
+	if (!sb->st_size) {
+		*hash = hash64(NULL, 0);
+		return 0;
+	}
+
+	data = mmap(NULL, sb->st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED)
+		return -1;
+
+	*hash = hash64(data, sb->st_size);
+	munmap(data, sb->st_size);
+
+	if (!memfd)
+		memo_add(sb, *hash);
+
+	return 0;
+}
+
+/**
+ * cache_init() - enable caching of resolved files
+ * @budget:	maximum number of bytes held by the cache
+ * @compress:	keep decompressed files compressed in memory
+ */
+void cache_init(size_t budget, bool compress)
+{
+	cache_budget = budget;
+	cache_limit = budget;
+	cache_compress = compress;
+
+	if (budget) {
+		membudget_register(cache_pressure);
+		cache_registered = true;
+	}
+}
+
+/**
+ * cache_resize() - change the maximum number of bytes held by the cache
+ * @budget:	new budget, 0 to disable caching
+ *
+ * Entries beyond the new budget are evicted, least recently used first.
+ */
+void cache_resize(size_t budget)
+{
+	if (budget && !cache_registered) {
+		membudget_register(cache_pressure);
+		cache_registered = true;
+	}
+
+	pthread_mutex_lock(&cache_lock);
+	cache_budget = budget;
+	cache_limit = cache_level < 2 ? budget : budget >> (cache_level - 1);
+	cache_shrink();
+	cache_save_index();
+	pthread_mutex_unlock(&cache_lock);
+}
+
+/**
+ * cache_flush() - evict all entries, pinned ones included
+ *
+ * Transfers reading from cached files keep their references.
+ */
+void cache_flush(void)
+{
+	pthread_mutex_lock(&cache_lock);
+	while (!list_empty(&entries))
+		cache_evict(list_entry_first(&entries, struct cache_entry, node));
+	cache_save_index();
+	pthread_mutex_unlock(&cache_lock);
+}
+
+/**
+ * cache_capacity() - maximum number of bytes held by the cache
+ */
+size_t cache_capacity(void)
+{
+	return cache_budget;
+}
+
+/**
+ * cache_open() - open a cached file
+ * @path:	path, as requested by the remote
+ * @fd:		set to a new fd referring to the cached file, or -1
+ * @blocks:	set to a new reference to the compressed copy of the file, or NULL
+ *
+ * Exactly one of @fd and @blocks refers to the file on success.
+ *
+ * Return: 0 on success, -1 if not cached
+ */
+int cache_open(const char *path, int *fd, struct blockcache_file **blocks)
+{
+	struct cache_entry *entry;
+	struct cache_object *obj;
+	int ret = -1;
+
+	*fd = -1;
+	*blocks = NULL;
+
+	pthread_mutex_lock(&cache_lock);
+	entry = cache_find(path);
+	if (entry) {
+		/* Move to the tail, to keep it around the longest */
+		list_del(&entry->node);
+		list_add(&entries, &entry->node);
+
+		obj = entry->obj;
+		if (obj->blocks) {
+			*blocks = blockcache_get(obj->blocks);
+			ret = 0;
+		} else {
+			*fd = dup(obj->fd);
+			ret = *fd < 0 ? -1 : 0;
+		}
+	}
+	pthread_mutex_unlock(&cache_lock);
+
+	return ret;
+}
+
+/*
+ * Add @path, resolved to @fd, to the cache. @stored is the id @fd was kept
+ * under in the fd store, if it was passed back after a restart, or 0.
+ *
+ * Return: id in the fd store of the file now referred to by @path, or 0
+ */
+static unsigned int cache_add(const char *path, int fd, unsigned int stored)
+{
+	struct cache_object *new_obj;
+	struct cache_object *obj;
+	struct cache_entry *entry;
+	struct cache_entry *lru;
+	struct stat sb;
+	uint64_t hash;
+	bool by_inode;
+	bool memfd;
+
+	if (!cache_limit || fstat(fd, &sb) < 0 || sb.st_size > cache_limit)
+		return 0;
+
+	/* Only memfds support seals */
+	memfd = fcntl(fd, F_GET_SEALS) >= 0;
+
+	if (content_hash(fd, &sb, memfd, &hash, &by_inode) < 0)
+		return 0;
+
+	entry = calloc(1, sizeof(*entry));
+	if (!entry)
+		return 0;
+	entry->path = strdup(path);
+
+	pthread_mutex_lock(&cache_lock);
+	if (cache_find(path))
+		goto out_free_entry;
+
+	obj = object_find(hash, by_inode, sb.st_size);
+	if (obj) {
+		obj->refs++;
+		goto out_add_entry;
+	}
+	pthread_mutex_unlock(&cache_lock);
+
+	new_obj = calloc(1, sizeof(*new_obj));
+	if (!new_obj)
+		goto out_unlocked;
+
+	new_obj->hash = hash;
+	new_obj->by_inode = by_inode;
+	new_obj->file_size = sb.st_size;
+	new_obj->refs = 1;
+
+	if (memfd)
+		new_obj->blocks = shmcache_get(fd, hash, sb.st_size);
+	if (!new_obj->blocks && cache_compress && memfd)
+		new_obj->blocks = blockcache_create(fd);
+
+	if (new_obj->blocks) {
+		new_obj->fd = -1;
+		new_obj->size = blockcache_footprint(new_obj->blocks);
+	} else {
+		new_obj->fd = dup(fd);
+		if (new_obj->fd < 0) {
+			free(new_obj);
+			goto out_unlocked;
+		}
+		new_obj->size = sb.st_size;
+	}
+
+	pthread_mutex_lock(&cache_lock);
+	if (cache_find(path)) {
+		object_free(new_obj);
+		goto out_free_entry;
+	}
+
+	/* Raced with another insertion of the same content */
+	obj = object_find(hash, by_inode, sb.st_size);
+	if (obj) {
+		object_free(new_obj);
+		obj->refs++;
+		goto out_add_entry;
+	}
+	obj = new_obj;
+
+	while (cache_size + obj->size > cache_limit && (lru = cache_lru()))
+		cache_evict(lru);
+
+	/* Decompressed content is what's worth keeping across a restart */
+	if (memfd && !obj->blocks)
+		obj->stored = stored ? stored : fdstore_add(obj->fd);
+
+	list_add(&objects, &obj->node);
+	cache_size += obj->size;
+	membudget_account(obj->blocks ? MEMBUDGET_CACHE_BLOCKS : MEMBUDGET_CACHE_FILES,
+			  obj->size);
+
+out_add_entry:
+	entry->obj = obj;
+	list_add(&entries, &entry->node);
+	stored = obj->stored;
+	cache_save_index();
+	pthread_mutex_unlock(&cache_lock);
+	return stored;
+
+out_free_entry:
+	pthread_mutex_unlock(&cache_lock);
+out_unlocked:
+	free(entry->path);
+	free(entry);
+	return 0;
+}
+
+/**
+ * cache_insert() - add a resolved file to the cache
+ * @path:	path, as requested by the remote
+ * @fd:		fd of the resolved file, the cache holds its own reference
+ *
+ * Least recently used files are evicted to make room for the new one, files
+ * larger than the entire budget are not cached.
+ *
+ * Content is keyed by hash, so that paths resolving to identical files, e.g.
+ * shared objects shipped with multiple remoteprocs, share a single copy.
+ *
+ * Decompressed files live in memfds, these are replaced by a copy in the
+ * region shared with other instances, if any, so that all of them serve the
+ * same pages. Otherwise they're replaced by a compressed copy if so
+ * configured. This keeps two to three times as many of them around, for the
+ * cost of inflating the chunks being read. Remaining memfds are kept in the
+ * service manager's fd store, if available.
+ */
+void cache_insert(const char *path, int fd)
+{
+	cache_add(path, fd, 0);
+}
+
+/**
+ * cache_restore() - add a file kept in the fd store across a restart
+ * @path:	path, as requested by the remote
+ * @fd:		fd passed back by the service manager
+ * @stored:	id the fd was stored under
+ *
+ * Return: true if the cache refers to the fd under @stored, false if it's no
+ * longer needed in the fd store
+ */
+bool cache_restore(const char *path, int fd, unsigned int stored)
+{
+	return cache_add(path, fd, stored) == stored;
+}
+
+/**
+ * cache_pin() - keep a cached file from being evicted to make room
+ * @path:	path, as requested by the remote
+ * @pin:	true to pin, false to unpin
+ *
+ * Pinned files still count against the budget, and are dropped by
+ * cache_flush().
+ *
+ * Return: 0 on success, -1 if @path isn't cached
+ */
+int cache_pin(const char *path, bool pin)
+{
+	struct cache_entry *entry;
+
+	pthread_mutex_lock(&cache_lock);
+	entry = cache_find(path);
+	if (entry)
+		entry->pinned = pin;
+	pthread_mutex_unlock(&cache_lock);
+
+	return entry ? 0 : -1;
+}
+
+/**
+ * cache_dump() - print the cached files, least recently used first
+ * @f:		stream to print to
+ */
+void cache_dump(FILE *f)
+{
+	struct cache_entry *entry;
+	struct cache_object *obj;
+
+	pthread_mutex_lock(&cache_lock);
+	fprintf(f, "size %zu limit %zu budget %zu\n",
+		cache_size, cache_limit, cache_budget);
+	list_for_each_entry(entry, &entries, node) {
+		obj = entry->obj;
+		fprintf(f, "%s %zu %zu%s%s%s\n", entry->path, obj->file_size,
+			obj->size, obj->blocks ? " compressed" : "",
+			obj->refs > 1 ? " shared" : "",
+			entry->pinned ? " pinned" : "");
+	}
+	pthread_mutex_unlock(&cache_lock);
+}
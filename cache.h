@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "profile.h"
+
+struct blockcache_file;
+
+#if TQFTP_WITH_CACHE
+void cache_init(size_t budget, bool compress);
+void cache_resize(size_t budget);
+void cache_flush(void);
+size_t cache_capacity(void);
+int cache_open(const char *path, int *fd, struct blockcache_file **blocks);
+void cache_insert(const char *path, int fd);
+bool cache_restore(const char *path, int fd, unsigned int stored);
+int cache_pin(const char *path, bool pin);
+void cache_dump(FILE *f);
+#else
+static inline void cache_init(size_t budget, bool compress) {}
+static inline void cache_resize(size_t budget) {}
+static inline void cache_flush(void) {}
+static inline size_t cache_capacity(void) { return 0; }
+static inline int cache_open(const char *path, int *fd,
+			     struct blockcache_file **blocks)
+{
+	*fd = -1;
+	*blocks = NULL;
+	return -1;
+}
+static inline void cache_insert(const char *path, int fd) {}
+static inline int cache_pin(const char *path, bool pin) { return -1; }
+static inline void cache_dump(FILE *f) {}
+#endif
+
+#endif
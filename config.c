@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include <ctype.h>
+#include <err.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "config.h"
+
+static const char * const log_levels[] = {
+	[LOG_ERR] = "error",
+	[LOG_WARNING] = "warning",
+	[LOG_INFO] = "info",
+	[LOG_DEBUG] = "debug",
+};
+
+static char *strip(char *s)
+{
+	char *end;
+
+	while (isspace((unsigned char)*s))
+		s++;
+
+	end = s + strlen(s);
+	while (end > s && isspace((unsigned char)end[-1]))
+		*--end = '\0';
+
+	return s;
+}
+
+static int parse_ulong(const char *value, unsigned long *out)
+{
+	char *end;
+
+	errno = 0;
+	*out = strtoul(value, &end, 10);
+	if (errno || end == value || *end || *value == '-')
+		return -1;
+
+	return 0;
+}
+
+static int parse_path(const char *value, char *out)
+{
+	if (*value != '/' || strlen(value) >= PATH_MAX)
+		return -1;
+
+	strcpy(out, value);
+
+	return 0;
+}
+
+static int parse_log_level(const char *value, int *out)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(log_levels) / sizeof(log_levels[0]); i++) {
+		if (log_levels[i] && !strcmp(value, log_levels[i])) {
+			*out = i;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * config_set() - set one tunable
+ * @cfg:	configuration to update
+ * @key:	name of the tunable, as in the config file
+ * @value:	new value, as in the config file
+ *
+ * Return: 0 on success, -1 if @key is unknown or @value invalid
+ */
+int config_set(struct tqftp_config *cfg, const char *key, const char *value)
+{
+	unsigned long n;
+
+	if (!strcmp(key, "firmware-root"))
+		return parse_path(value, cfg->firmware_root);
+	if (!strcmp(key, "readwrite-root"))
+		return parse_path(value, cfg->readwrite_root);
+	if (!strcmp(key, "log-level"))
+		return parse_log_level(value, &cfg->log_level);
+
+	if (parse_ulong(value, &n) < 0)
+		return -1;
+
+	if (!strcmp(key, "blksize"))
+		cfg->blksize = n;
+	else if (!strcmp(key, "wsize"))
+		cfg->wsize = n;
+	else if (!strcmp(key, "timeout"))
+		cfg->timeoutms = n;
+	else if (!strcmp(key, "max-blksize"))
+		cfg->max_blksize = n;
+	else if (!strcmp(key, "max-wsize"))
+		cfg->max_wsize = n;
+	else if (!strcmp(key, "retransmit"))
+		cfg->retransmits = n;
+	else if (!strcmp(key, "cache-size"))
+		cfg->cache_size = n * 1024 * 1024;
+	else if (!strcmp(key, "predict-size"))
+		cfg->predict_size = n * 1024 * 1024;
+	else
+		return -1;
+
+	return 0;
+}
+
+/**
+ * config_load() - read tunables from a config file
+ * @path:	config file to read
+ * @cfg:	updated with the values found in the file, others left as is
+ *
+ * Lines are of the form "key = value", empty lines and lines starting with
+ * '#' are ignored. @cfg is only updated if the whole file is valid.
+ *
+ * Return: 0 on success, -1 on error with errno set to ENOENT if the file
+ * doesn't exist
+ */
+int config_load(const char *path, struct tqftp_config *cfg)
+{
+	struct tqftp_config new = *cfg;
+	unsigned int lineno = 0;
+	char line[PATH_MAX + 64];
+	char *value;
+	char *key;
+	int ret = 0;
+	FILE *f;
+
+	f = fopen(path, "re");
+	if (!f)
+		return -1;
+
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+
+		key = strip(line);
+		if (!*key || *key == '#')
+			continue;
+
+		value = strchr(key, '=');
+		if (!value) {
+			warnx("%s:%u: expected \"key = value\"", path, lineno);
+			ret = -1;
+			continue;
+		}
+		*value++ = '\0';
+
+		key = strip(key);
+		value = strip(value);
+		if (config_set(&new, key, value) < 0) {
+			warnx("%s:%u: invalid %s \"%s\"", path, lineno, key, value);
+			ret = -1;
+		}
+	}
+	fclose(f);
+
+	if (ret < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	*cfg = new;
+
+	return 0;
+}
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __CONFIG_H__
+#define __CONFIG_H__
+
+#include <sys/types.h>
+#include <limits.h>
+
+#ifndef ANDROID
+#define CONFIG_PATH	"/etc/tqftpserv.conf"
+#else
+#define CONFIG_PATH	"/vendor/etc/tqftpserv.conf"
+#endif
+
+/* Tunables, each one settable by a "key = value" line of the config file */
+struct tqftp_config {
+	/* "blksize", "wsize" and "timeout": used unless negotiated */
+	size_t blksize;
+	size_t wsize;
+	unsigned int timeoutms;
+
+	/* "max-blksize" and "max-wsize": most that is negotiated, 0 for no limit */
+	size_t max_blksize;
+	size_t max_wsize;
+
+	/* "retransmit": times an unacknowledged window is sent again */
+	unsigned int retransmits;
+
+	/* "cache-size" and "predict-size", in MiB; -1 leaves the cache as is */
+	ssize_t cache_size;
+	size_t predict_size;
+
+	/* "firmware-root" and "readwrite-root": empty for the built-in ones */
+	char firmware_root[PATH_MAX];
+	char readwrite_root[PATH_MAX];
+
+	/* "log-level": error, warning, info or debug, as syslog levels */
+	int log_level;
+};
+
+int config_load(const char *path, struct tqftp_config *cfg);
+int config_set(struct tqftp_config *cfg, const char *key, const char *value);
+
+#endif
@@ -0,0 +1,276 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+/* For accept4 and struct ucred */
+#define _GNU_SOURCE
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <err.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "control.h"
+
+/* Abstract socket, e.g. socat - ABSTRACT-CONNECT:tqftpserv-control */
+#define CONTROL_SOCKET		"tqftpserv-control"
+
+#define CONTROL_MAX_CONNS	4
+#define CONTROL_LINE_MAX	512
+
+struct control_conn {
+	int fd;
+
+	/* Received, not yet run */
+	char in[CONTROL_LINE_MAX];
+	size_t inlen;
+
+	/* Response not yet sent */
+	char *out;
+	size_t outlen;
+	size_t outoff;
+};
+
+static struct control_conn conns[CONTROL_MAX_CONNS];
+static control_cmd_fn control_cmd;
+static int control_fd = -1;
+
+/**
+ * control_init() - listen for administrative commands
+ * @fn:		called to run each command
+ *
+ * Commands are lines of text, each response ends with an empty line. Only
+ * root and the user the service runs as may connect.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int control_init(control_cmd_fn fn)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	socklen_t addrlen;
+	int i;
+
+	for (i = 0; i < CONTROL_MAX_CONNS; i++)
+		conns[i].fd = -1;
+
+	control_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (control_fd < 0) {
+		warn("failed to create control socket");
+		return -1;
+	}
+
+	/* Leading NUL, for the abstract namespace */
+	strcpy(addr.sun_path + 1, CONTROL_SOCKET);
+	addrlen = offsetof(struct sockaddr_un, sun_path) + 1 + strlen(CONTROL_SOCKET);
+
+	if (bind(control_fd, (struct sockaddr *)&addr, addrlen) < 0 ||
+	    listen(control_fd, CONTROL_MAX_CONNS) < 0) {
+		warn("failed to listen on control socket");
+		close(control_fd);
+		control_fd = -1;
+		return -1;
+	}
+
+	control_cmd = fn;
+
+	return 0;
+}
+
+/**
+ * control_exit() - stop listening, for another process to take over
+ */
+void control_exit(void)
+{
+	int i;
+
+	for (i = 0; i < CONTROL_MAX_CONNS; i++) {
+		if (conns[i].fd >= 0)
+			close(conns[i].fd);
+	}
+
+	if (control_fd >= 0)
+		close(control_fd);
+	control_fd = -1;
+}
+
+static void control_close(struct control_conn *conn)
+{
+	close(conn->fd);
+	free(conn->out);
+	memset(conn, 0, sizeof(*conn));
+	conn->fd = -1;
+}
+
+static void control_accept(void)
+{
+	struct control_conn *conn = NULL;
+	struct ucred cred;
+	socklen_t credlen = sizeof(cred);
+	int fd;
+	int i;
+
+	fd = accept4(control_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+	if (fd < 0)
+		return;
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) < 0 ||
+	    (cred.uid != 0 && cred.uid != geteuid())) {
+		close(fd);
+		return;
+	}
+
+	for (i = 0; i < CONTROL_MAX_CONNS; i++) {
+		if (conns[i].fd < 0) {
+			conn = &conns[i];
+			break;
+		}
+	}
+
+	if (!conn) {
+		close(fd);
+		return;
+	}
+
+	conn->fd = fd;
+}
+
+/* Send what the socket takes of the pending response, without blocking */
+static int control_flush(struct control_conn *conn)
+{
+	ssize_t n;
+
+	while (conn->outoff < conn->outlen) {
+		n = send(conn->fd, conn->out + conn->outoff,
+			 conn->outlen - conn->outoff, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (n < 0)
+			return errno == EAGAIN ? 0 : -1;
+		conn->outoff += n;
+	}
+
+	free(conn->out);
+	conn->out = NULL;
+	conn->outlen = 0;
+	conn->outoff = 0;
+
+	return 0;
+}
+
+/* Run the received commands, one at a time as responses get sent */
+static int control_run(struct control_conn *conn)
+{
+	char *nl;
+	FILE *f;
+
+	while (!conn->out && (nl = memchr(conn->in, '\n', conn->inlen))) {
+		*nl = '\0';
+		if (nl > conn->in && nl[-1] == '\r')
+			nl[-1] = '\0';
+
+		f = open_memstream(&conn->out, &conn->outlen);
+		if (!f)
+			return -1;
+		control_cmd(conn->in, f);
+		fputc('\n', f);
+		fclose(f);
+
+		conn->inlen -= nl + 1 - conn->in;
+		memmove(conn->in, nl + 1, conn->inlen);
+
+		if (control_flush(conn) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int control_read(struct control_conn *conn)
+{
+	ssize_t n;
+
+	n = recv(conn->fd, conn->in + conn->inlen,
+		 sizeof(conn->in) - conn->inlen, MSG_DONTWAIT);
+	if (n < 0)
+		return errno == EAGAIN ? 0 : -1;
+	if (n == 0)
+		return -1;
+
+	conn->inlen += n;
+
+	/* Drop the connection of anyone sending overly long lines */
+	if (conn->inlen == sizeof(conn->in) &&
+	    !memchr(conn->in, '\n', conn->inlen))
+		return -1;
+
+	return control_run(conn);
+}
+
+/**
+ * control_fds() - add the control sockets to the sets waited upon
+ * @rfds:	set of fds waited upon to be readable
+ * @wfds:	set of fds waited upon to be writable
+ * @nfds:	updated with the highest fd added
+ */
+void control_fds(fd_set *rfds, fd_set *wfds, int *nfds)
+{
+	int i;
+
+	if (control_fd < 0)
+		return;
+
+	FD_SET(control_fd, rfds);
+	if (control_fd > *nfds)
+		*nfds = control_fd;
+
+	for (i = 0; i < CONTROL_MAX_CONNS; i++) {
+		if (conns[i].fd < 0)
+			continue;
+
+		/* Stop reading commands until the last response is sent */
+		FD_SET(conns[i].fd, conns[i].out ? wfds : rfds);
+		if (conns[i].fd > *nfds)
+			*nfds = conns[i].fd;
+	}
+}
+
+/**
+ * control_handle() - accept connections, run commands and send responses
+ * @rfds:	set of fds found readable
+ * @wfds:	set of fds found writable
+ */
+void control_handle(const fd_set *rfds, const fd_set *wfds)
+{
+	struct control_conn *conn;
+	int ret;
+	int i;
+
+	if (control_fd < 0)
+		return;
+
+	for (i = 0; i < CONTROL_MAX_CONNS; i++) {
+		conn = &conns[i];
+		if (conn->fd < 0)
+			continue;
+
+		if (FD_ISSET(conn->fd, wfds)) {
+			ret = control_flush(conn);
+			if (!ret)
+				ret = control_run(conn);
+		} else if (FD_ISSET(conn->fd, rfds)) {
+			ret = control_read(conn);
+		} else {
+			continue;
+		}
+
+		if (ret < 0)
+			control_close(conn);
+	}
+
+	if (FD_ISSET(control_fd, rfds))
+		control_accept();
+}
@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __CONTROL_H__
+#define __CONTROL_H__
+
+#include <sys/select.h>
+#include <stdio.h>
+
+/* Runs one command, with its arguments, printing the response to @out */
+typedef void (*control_cmd_fn)(char *line, FILE *out);
+
+int control_init(control_cmd_fn fn);
+void control_exit(void);
+void control_fds(fd_set *rfds, fd_set *wfds, int *nfds);
+void control_handle(const fd_set *rfds, const fd_set *wfds);
+
+#endif
@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+/* For memfd_create */
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "fdstore.h"
+#include "list.h"
+#include "sdnotify.h"
+
+#define FDSTORE_INDEX		"index"
+#define FDSTORE_PREFIX		"cache-"
+
+/* An fd passed back by the service manager on startup */
+struct stored_fd {
+	struct list_head node;
+
+	int fd;
+	char *name;
+	bool adopted;
+};
+
+static int index_fd = -1;
+static unsigned int next_id = 1;
+
+static void fdstore_collect(int fd, const char *name, void *data)
+{
+	struct list_head *passed = data;
+	struct stored_fd *sfd;
+
+	sfd = calloc(1, sizeof(*sfd));
+	if (!sfd) {
+		close(fd);
+		return;
+	}
+
+	sfd->fd = fd;
+	sfd->name = strdup(name);
+	list_add(passed, &sfd->node);
+}
+
+static struct stored_fd *fdstore_find(struct list_head *passed,
+				      const char *name)
+{
+	struct stored_fd *sfd;
+
+	list_for_each_entry(sfd, passed, node) {
+		if (!strcmp(sfd->name, name))
+			return sfd;
+	}
+
+	return NULL;
+}
+
+/* Rebuild the cache from the index, and the fds it refers to */
+static void fdstore_restore(struct list_head *passed)
+{
+	struct stored_fd *sfd;
+	char name[32];
+	unsigned int id;
+	struct stat sb;
+	char *saveptr;
+	char *line;
+	char *path;
+	char *buf;
+
+	if (fstat(index_fd, &sb) < 0 || !sb.st_size)
+		return;
+
+	/* Read it all up front, the index is rewritten as entries are added */
+	buf = calloc(1, sb.st_size + 1);
+	if (!buf)
+		return;
+
+	if (pread(index_fd, buf, sb.st_size, 0) != sb.st_size)
+		goto out;
+
+	for (line = strtok_r(buf, "\n", &saveptr); line;
+	     line = strtok_r(NULL, "\n", &saveptr)) {
+		id = strtoul(line, &path, 10);
+		if (!id || *path != ' ')
+			continue;
+		path++;
+
+		if (id >= next_id)
+			next_id = id + 1;
+
+		snprintf(name, sizeof(name), FDSTORE_PREFIX "%u", id);
+		sfd = fdstore_find(passed, name);
+		if (!sfd)
+			continue;
+
+		if (cache_restore(path, sfd->fd, id))
+			sfd->adopted = true;
+	}
+
+out:
+	free(buf);
+}
+
+/**
+ * fdstore_init() - keep cached files in the service manager's fd store
+ *
+ * Decompressed files are pushed to the fd store as they're cached, along
+ * with an index of the paths resolving to them; so that a restarted daemon
+ * picks up where the previous one left off rather than decompressing all
+ * over again. Stored fds no longer referred to by the cache are dropped.
+ *
+ * Requires FileDescriptorStoreMax= to be set in the service unit.
+ *
+ * Return: 0 on success, -1 if the fd store is unavailable
+ */
+int fdstore_init(void)
+{
+	struct list_head passed = LIST_INIT(passed);
+	struct stored_fd *sfd;
+	struct stored_fd *next;
+	char state[64];
+	int fd;
+
+	if (!sdnotify_available())
+		return -1;
+
+	sdnotify_listen_fds(fdstore_collect, &passed);
+
+	sfd = fdstore_find(&passed, FDSTORE_INDEX);
+	if (sfd) {
+		index_fd = sfd->fd;
+		sfd->adopted = true;
+		fdstore_restore(&passed);
+	} else {
+		fd = memfd_create("tqftpserv-index", MFD_CLOEXEC);
+		if (fd >= 0 &&
+		    sdnotify_fds("FDSTORE=1\nFDNAME=" FDSTORE_INDEX, &fd, 1) < 0) {
+			close(fd);
+			fd = -1;
+		}
+		index_fd = fd;
+	}
+
+	list_for_each_entry_safe(sfd, next, &passed, node) {
+		if (!sfd->adopted) {
+			snprintf(state, sizeof(state),
+				 "FDSTOREREMOVE=1\nFDNAME=%s", sfd->name);
+			sdnotify(state);
+		}
+
+		/* The cache holds its own references */
+		if (sfd->fd != index_fd)
+			close(sfd->fd);
+
+		list_del(&sfd->node);
+		free(sfd->name);
+		free(sfd);
+	}
+
+	if (index_fd < 0) {
+		warnx("file descriptor store unavailable");
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * fdstore_active() - check if cached files are kept in the fd store
+ */
+bool fdstore_active(void)
+{
+	return index_fd >= 0;
+}
+
+/**
+ * fdstore_add() - push a cached file to the fd store
+ * @fd:		fd to keep across restarts
+ *
+ * Return: id to refer to @fd by in the index, 0 on failure
+ */
+unsigned int fdstore_add(int fd)
+{
+	char state[64];
+	unsigned int id;
+
+	if (index_fd < 0)
+		return 0;
+
+	id = next_id++;
+	snprintf(state, sizeof(state), "FDSTORE=1\nFDNAME=" FDSTORE_PREFIX "%u", id);
+	if (sdnotify_fds(state, &fd, 1) < 0)
+		return 0;
+
+	return id;
+}
+
+/**
+ * fdstore_remove() - drop a cached file from the fd store
+ * @id:		id returned by fdstore_add()
+ */
+void fdstore_remove(unsigned int id)
+{
+	char state[64];
+
+	snprintf(state, sizeof(state), "FDSTOREREMOVE=1\nFDNAME=" FDSTORE_PREFIX "%u", id);
+	sdnotify(state);
+}
+
+/**
+ * fdstore_save_index() - replace the index of stored files
+ * @buf:	lines of "<id> <path>"
+ * @len:	length of @buf
+ *
+ * The index lives in a memfd which is itself kept in the fd store, so it's
+ * updated in place.
+ */
+void fdstore_save_index(const char *buf, size_t len)
+{
+	if (index_fd < 0)
+		return;
+
+	if (ftruncate(index_fd, 0) < 0 || pwrite(index_fd, buf, len, 0) != len)
+		warn("failed to update fd store index");
+}
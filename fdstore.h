@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __FDSTORE_H__
+#define __FDSTORE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "profile.h"
+
+#if TQFTP_WITH_CACHE
+int fdstore_init(void);
+bool fdstore_active(void);
+unsigned int fdstore_add(int fd);
+void fdstore_remove(unsigned int id);
+void fdstore_save_index(const char *buf, size_t len);
+#else
+static inline int fdstore_init(void) { return -1; }
+#endif
+
+#endif
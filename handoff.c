@@ -0,0 +1,219 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+/* For accept4 and struct ucred */
+#define _GNU_SOURCE
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <err.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "handoff.h"
+
+/* Abstract socket, suffixed by the pid of the process handing off */
+#define HANDOFF_SOCKET		"tqftpserv-handoff-%d"
+
+static socklen_t handoff_addr(struct sockaddr_un *addr, pid_t pid)
+{
+	int len;
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	/* Leading NUL, for the abstract namespace */
+	len = snprintf(addr->sun_path + 1, sizeof(addr->sun_path) - 1,
+		       HANDOFF_SOCKET, pid);
+
+	return offsetof(struct sockaddr_un, sun_path) + 1 + len;
+}
+
+/**
+ * handoff_listen() - wait for a new process to take over
+ *
+ * Return: listening socket to pass to handoff_accept(), -1 on error
+ */
+int handoff_listen(void)
+{
+	struct sockaddr_un addr;
+	socklen_t addrlen;
+	int sock;
+
+	sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (sock < 0) {
+		warn("failed to create handoff socket");
+		return -1;
+	}
+
+	addrlen = handoff_addr(&addr, getpid());
+	if (bind(sock, (struct sockaddr *)&addr, addrlen) < 0 ||
+	    listen(sock, 1) < 0) {
+		warn("failed to listen on handoff socket");
+		close(sock);
+		return -1;
+	}
+
+	return sock;
+}
+
+/**
+ * handoff_accept() - accept a connection from the process taking over
+ * @sock:	listening socket returned by handoff_listen()
+ * @pid:	set to the pid of the process taking over
+ *
+ * Only processes running as the same user may take over.
+ *
+ * Return: connected socket to pass to handoff_send(), -1 on error
+ */
+int handoff_accept(int sock, pid_t *pid)
+{
+	struct ucred cred;
+	socklen_t credlen = sizeof(cred);
+	int fd;
+
+	fd = accept4(sock, NULL, NULL, SOCK_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	if (cred.uid != geteuid()) {
+		warnx("rejecting handoff to uid %d", cred.uid);
+		close(fd);
+		return -1;
+	}
+
+	*pid = cred.pid;
+
+	return fd;
+}
+
+/**
+ * handoff_connect() - connect to the process to take over from
+ * @pid:	pid of the running process
+ *
+ * Return: connected socket to pass to handoff_recv(), -1 on error
+ */
+int handoff_connect(pid_t pid)
+{
+	struct sockaddr_un addr;
+	socklen_t addrlen;
+	int sock;
+
+	sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (sock < 0)
+		return -1;
+
+	addrlen = handoff_addr(&addr, pid);
+	if (connect(sock, (struct sockaddr *)&addr, addrlen) < 0) {
+		close(sock);
+		return -1;
+	}
+
+	return sock;
+}
+
+/**
+ * handoff_send() - pass one piece of state to the process taking over
+ * @sock:	socket returned by handoff_accept()
+ * @item:	state to pass, only the used part of the filename is sent
+ * @fds:	fds to pass along, -1 for none
+ *
+ * Return: 0 on success, -1 on error
+ */
+int handoff_send(int sock, const struct handoff_item *item,
+		 const int fds[HANDOFF_MAX_FDS])
+{
+	char control[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)] = {};
+	struct msghdr msg = {};
+	struct cmsghdr *cmsg;
+	int passed[HANDOFF_MAX_FDS];
+	struct iovec iov;
+	unsigned int n = 0;
+	unsigned int i;
+
+	for (i = 0; i < HANDOFF_MAX_FDS; i++) {
+		if (fds[i] >= 0)
+			passed[n++] = fds[i];
+	}
+
+	iov.iov_base = (void *)item;
+	iov.iov_len = offsetof(struct handoff_item, filename) +
+		      strlen(item->filename) + 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if (n) {
+		msg.msg_control = control;
+		msg.msg_controllen = CMSG_SPACE(sizeof(int) * n);
+
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * n);
+		memcpy(CMSG_DATA(cmsg), passed, sizeof(int) * n);
+	}
+
+	return sendmsg(sock, &msg, MSG_NOSIGNAL) < 0 ? -1 : 0;
+}
+
+/**
+ * handoff_recv() - receive one piece of state from the process handing off
+ * @sock:	socket returned by handoff_connect()
+ * @item:	filled in with the received state
+ * @fds:	filled in with the received fds, in the order they were sent,
+ *		-1 for each one not passed
+ *
+ * Return: 1 when state was received, 0 once all state was received, -1 on
+ * error
+ */
+int handoff_recv(int sock, struct handoff_item *item, int fds[HANDOFF_MAX_FDS])
+{
+	char control[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)];
+	struct msghdr msg = {};
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	unsigned int n;
+	unsigned int i;
+	ssize_t len;
+
+	for (i = 0; i < HANDOFF_MAX_FDS; i++)
+		fds[i] = -1;
+
+	memset(item, 0, sizeof(*item));
+	iov.iov_base = item;
+	iov.iov_len = sizeof(*item);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	len = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+	if (len <= 0)
+		return len;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg && cmsg->cmsg_level == SOL_SOCKET &&
+	    cmsg->cmsg_type == SCM_RIGHTS) {
+		n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * n);
+	}
+
+	if (len < offsetof(struct handoff_item, filename) ||
+	    item->version != HANDOFF_VERSION) {
+		warnx("incompatible handoff state");
+		return -1;
+	}
+
+	item->filename[sizeof(item->filename) - 1] = '\0';
+
+	return 1;
+}
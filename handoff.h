@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __HANDOFF_H__
+#define __HANDOFF_H__
+
+#include <sys/types.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HANDOFF_VERSION		3
+
+/* Each item carries at most a client's socket and file */
+#define HANDOFF_MAX_FDS		2
+
+enum handoff_type {
+	HANDOFF_SERVICE,
+	HANDOFF_READER,
+	HANDOFF_WRITER,
+};
+
+/* State passed from a running process to the one taking over from it */
+struct handoff_item {
+	uint32_t version;
+	uint32_t type;
+
+	uint32_t node;
+	uint32_t port;
+
+	int64_t tsize;
+	uint64_t blksize;
+	uint64_t rsize;
+	uint64_t wsize;
+	uint32_t timeoutms;
+	int64_t seek;
+
+	/* Readers: size of the file, CLOCK_MONOTONIC start, admission charge */
+	uint64_t size;
+	int64_t started_sec;
+	int64_t started_nsec;
+	uint64_t charged;
+	uint32_t acked;
+
+	/* When the window or the answer to the request was sent, if unanswered */
+	int64_t sent_sec;
+	int64_t sent_nsec;
+	bool awaiting_ack;
+	bool oack_pending;
+
+	int64_t written;
+	int64_t synced;
+	bool no_writeback;
+
+	char filename[PATH_MAX];
+};
+
+int handoff_listen(void);
+int handoff_accept(int sock, pid_t *pid);
+int handoff_connect(pid_t pid);
+int handoff_send(int sock, const struct handoff_item *item,
+		 const int fds[HANDOFF_MAX_FDS]);
+int handoff_recv(int sock, struct handoff_item *item, int fds[HANDOFF_MAX_FDS]);
+
+#endif
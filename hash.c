@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include <string.h>
+
+#include "hash.h"
+
+/*
+ * XXH64, processing four independent 64-bit lanes per 32 byte stripe; which
+ * lets the compiler keep the lanes in flight in parallel.
+ */
+#define PRIME1	0x9e3779b185ebca87ULL
+#define PRIME2	0xc2b2ae3d27d4eb4fULL
+#define PRIME3	0x165667b19e3779f9ULL
+#define PRIME4	0x85ebca77c2b2ae63ULL
+#define PRIME5	0x27d4eb2f165667c5ULL
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const uint8_t *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t read32(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input)
+{
+	acc += input * PRIME2;
+	acc = rotl64(acc, 31);
+	return acc * PRIME1;
+}
+
+static inline uint64_t merge64(uint64_t acc, uint64_t val)
+{
+	acc ^= round64(0, val);
+	return acc * PRIME1 + PRIME4;
+}
+
+/**
+ * hash64() - fast, non-cryptographic, 64-bit hash of a buffer
+ * @data:	buffer to hash
+ * @len:	length of @data
+ *
+ * Return: XXH64 hash of @data, with seed 0
+ */
+uint64_t hash64(const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	const uint8_t *end = p + len;
+	uint64_t v1 = PRIME1 + PRIME2;
+	uint64_t v2 = PRIME2;
+	uint64_t v3 = 0;
+	uint64_t v4 = -PRIME1;
+	uint64_t h;
+
+	if (len >= 32) {
+		do {
+			v1 = round64(v1, read64(p));
+			v2 = round64(v2, read64(p + 8));
+			v3 = round64(v3, read64(p + 16));
+			v4 = round64(v4, read64(p + 24));
+			p += 32;
+		} while (p + 32 <= end);
+
+		h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		h = merge64(h, v1);
+		h = merge64(h, v2);
+		h = merge64(h, v3);
+		h = merge64(h, v4);
+	} else {
+		h = PRIME5;
+	}
+
+	h += len;
+
+	while (p + 8 <= end) {
+		h ^= round64(0, read64(p));
+		h = rotl64(h, 27) * PRIME1 + PRIME4;
+		p += 8;
+	}
+
+	if (p + 4 <= end) {
+		h ^= (uint64_t)read32(p) * PRIME1;
+		h = rotl64(h, 23) * PRIME2 + PRIME3;
+		p += 4;
+	}
+
+	while (p < end) {
+		h ^= *p * PRIME5;
+		h = rotl64(h, 11) * PRIME1;
+		p++;
+	}
+
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+
+	return h;
+}
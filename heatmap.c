@@ -0,0 +1,447 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include <sys/stat.h>
+#include <err.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "heatmap.h"
+#include "list.h"
+
+/* Files tracked, requests for others aren't recorded */
+#define HEATMAP_MAX_FILES	256
+
+/* Distinct remote nodes recorded per file */
+#define HEATMAP_NODES		16
+
+/* Bucket 0 counts zero, bucket n values in [2^(n-1), 2^n) bytes */
+#define HEATMAP_BUCKETS		32
+
+/* Each bit of the range map stands for a 64th of the file */
+#define HEATMAP_RANGES		64
+
+/* How often, in ms, the heat map is saved while requests come in */
+#define HEATMAP_SAVE_INTERVAL	300000
+
+struct heatmap_file {
+	struct list_head node;
+
+	char *path;
+	size_t size;
+
+	uint64_t requests;
+	uint64_t bytes;
+
+	unsigned int nodes[HEATMAP_NODES];
+	unsigned int nnodes;
+
+	/* Requested seek offsets and rsize limits, 0 when not requested */
+	uint64_t seeks[HEATMAP_BUCKETS];
+	uint64_t rsizes[HEATMAP_BUCKETS];
+
+	uint64_t ranges;
+};
+
+static struct list_head files = LIST_INIT(files);
+static unsigned int nfiles;
+
+static bool dirty;
+static struct timespec last_save;
+
+static long elapsed_ms(const struct timespec *since)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - since->tv_sec) * 1000 +
+	       (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+static unsigned int heatmap_bucket(uint64_t value)
+{
+	unsigned int bucket = 0;
+
+	for (; value && bucket < HEATMAP_BUCKETS - 1; value >>= 1)
+		bucket++;
+
+	return bucket;
+}
+
+static struct heatmap_file *heatmap_find(const char *path)
+{
+	struct heatmap_file *file;
+
+	list_for_each_entry(file, &files, node) {
+		if (!strcmp(file->path, path))
+			return file;
+	}
+
+	return NULL;
+}
+
+static struct heatmap_file *heatmap_add(const char *path)
+{
+	struct heatmap_file *file;
+
+	if (nfiles == HEATMAP_MAX_FILES)
+		return NULL;
+
+	file = calloc(1, sizeof(*file));
+	if (!file)
+		return NULL;
+
+	file->path = strdup(path);
+	if (!file->path) {
+		free(file);
+		return NULL;
+	}
+
+	list_add(&files, &file->node);
+	nfiles++;
+
+	return file;
+}
+
+static void heatmap_add_node(struct heatmap_file *file, unsigned int node_id)
+{
+	unsigned int i;
+
+	for (i = 0; i < file->nnodes; i++) {
+		if (file->nodes[i] == node_id)
+			return;
+	}
+
+	if (file->nnodes < HEATMAP_NODES)
+		file->nodes[file->nnodes++] = node_id;
+}
+
+/* Parse a list of bucket:count pairs, as written by heatmap_write_buckets() */
+static void heatmap_parse_buckets(char *s, uint64_t *buckets)
+{
+	unsigned long bucket;
+	char *end;
+
+	while (*s && *s != '-') {
+		bucket = strtoul(s, &end, 10);
+		if (*end != ':')
+			return;
+
+		if (bucket < HEATMAP_BUCKETS)
+			buckets[bucket] = strtoull(end + 1, &end, 10);
+		if (*end != ',')
+			return;
+		s = end + 1;
+	}
+}
+
+static void heatmap_write_buckets(FILE *f, const uint64_t *buckets)
+{
+	const char *sep = "";
+	int i;
+
+	for (i = 0; i < HEATMAP_BUCKETS; i++) {
+		if (!buckets[i])
+			continue;
+
+		fprintf(f, "%s%d:%llu", sep, i, (unsigned long long)buckets[i]);
+		sep = ",";
+	}
+
+	fprintf(f, "%s", *sep ? " " : "- ");
+}
+
+/**
+ * heatmap_init() - load the heat map saved by previous runs
+ */
+void heatmap_init(void)
+{
+	struct heatmap_file *file;
+	unsigned long long requests;
+	unsigned long long ranges;
+	unsigned long long bytes;
+	char path[PATH_MAX];
+	char rsizes[1024];
+	char seeks[1024];
+	char nodes[256];
+	char fmt[64];
+	size_t size;
+	char *s;
+	FILE *f;
+
+	clock_gettime(CLOCK_MONOTONIC, &last_save);
+
+	f = fopen(HEATMAP_PATH, "r");
+	if (!f)
+		return;
+
+	/* The path is last, as it may contain spaces */
+	snprintf(fmt, sizeof(fmt), "%%llu %%llu %%zu %%llx %%255s %%1023s %%1023s %%%d[^\n]",
+		 PATH_MAX - 1);
+	while (fscanf(f, fmt, &requests, &bytes, &size, &ranges, nodes, seeks,
+		      rsizes, path) == 8) {
+		file = heatmap_find(path);
+		if (!file)
+			file = heatmap_add(path);
+		if (!file)
+			break;
+
+		file->requests = requests;
+		file->bytes = bytes;
+		file->size = size;
+		file->ranges = ranges;
+
+		for (s = nodes; *s && *s != '-'; s++) {
+			heatmap_add_node(file, strtoul(s, &s, 10));
+			if (*s != ',')
+				break;
+		}
+
+		heatmap_parse_buckets(seeks, file->seeks);
+		heatmap_parse_buckets(rsizes, file->rsizes);
+	}
+
+	fclose(f);
+}
+
+/**
+ * heatmap_request() - record a read request
+ * @path:	file requested
+ * @node_id:	qrtr node of the remote requesting it
+ * @seek:	offset requested, 0 if none
+ * @rsize:	amount of data requested, 0 for the whole file
+ * @size:	size of the file
+ *
+ * Return: the file's entry, for heatmap_read(), NULL if not tracked
+ */
+struct heatmap_file *heatmap_request(const char *path, unsigned int node_id,
+				     off_t seek, size_t rsize, size_t size)
+{
+	struct heatmap_file *file;
+
+	file = heatmap_find(path);
+	if (!file)
+		file = heatmap_add(path);
+	if (!file)
+		return NULL;
+
+	/* Blocks read from a previous version of the file no longer tell much */
+	if (file->size != size) {
+		file->size = size;
+		file->ranges = 0;
+	}
+
+	file->requests++;
+	heatmap_add_node(file, node_id);
+	file->seeks[heatmap_bucket(seek)]++;
+	file->rsizes[heatmap_bucket(rsize)]++;
+	dirty = true;
+
+	return file;
+}
+
+/**
+ * heatmap_lookup() - find the entry of a file, without recording a request
+ * @path:	file requested
+ *
+ * For transfers taken over from another process, which recorded the request.
+ *
+ * Return: the file's entry, for heatmap_read(), NULL if not tracked
+ */
+struct heatmap_file *heatmap_lookup(const char *path)
+{
+	return heatmap_find(path);
+}
+
+/**
+ * heatmap_read() - record data sent from a file
+ * @file:	entry returned by heatmap_request(), may be NULL
+ * @offset:	offset of the data in the file
+ * @len:	length of the data
+ */
+void heatmap_read(struct heatmap_file *file, size_t offset, size_t len)
+{
+	unsigned int first;
+	unsigned int last;
+
+	if (!file || !len)
+		return;
+
+	file->bytes += len;
+	dirty = true;
+
+	if (!file->size || offset >= file->size)
+		return;
+
+	first = (uint64_t)offset * HEATMAP_RANGES / file->size;
+	last = (uint64_t)(offset + len - 1) * HEATMAP_RANGES / file->size;
+	if (last >= HEATMAP_RANGES)
+		last = HEATMAP_RANGES - 1;
+
+	for (; first <= last; first++)
+		file->ranges |= 1ULL << first;
+}
+
+/**
+ * heatmap_save() - write the heat map to HEATMAP_PATH
+ */
+void heatmap_save(void)
+{
+	struct heatmap_file *file;
+	char tmp[PATH_MAX];
+	const char *sep;
+	unsigned int i;
+	char *dir;
+	FILE *f;
+
+	dirty = false;
+	clock_gettime(CLOCK_MONOTONIC, &last_save);
+
+	if (list_empty(&files))
+		return;
+
+	dir = strdup(HEATMAP_PATH);
+	mkdir(dirname(dir), 0700);
+	free(dir);
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", HEATMAP_PATH);
+	f = fopen(tmp, "w");
+	if (!f) {
+		warn("failed to save heat map");
+		return;
+	}
+
+	list_for_each_entry(file, &files, node) {
+		fprintf(f, "%llu %llu %zu %llx ", (unsigned long long)file->requests,
+			(unsigned long long)file->bytes, file->size,
+			(unsigned long long)file->ranges);
+
+		sep = "";
+		for (i = 0; i < file->nnodes; i++) {
+			fprintf(f, "%s%u", sep, file->nodes[i]);
+			sep = ",";
+		}
+		fprintf(f, "%s", *sep ? " " : "- ");
+
+		heatmap_write_buckets(f, file->seeks);
+		heatmap_write_buckets(f, file->rsizes);
+		fprintf(f, "%s\n", file->path);
+	}
+
+	/*
+	 * The map only steers prefetching, so it isn't synced: this runs in
+	 * the main loop, and a map lost or cut short by a crash is merely
+	 * rebuilt, heatmap_init() stopping at the first malformed line.
+	 */
+	if (fclose(f) || rename(tmp, HEATMAP_PATH) < 0) {
+		warn("failed to save heat map");
+		unlink(tmp);
+	}
+}
+
+/**
+ * heatmap_timeout() - time until heatmap_tick() needs to be called
+ *
+ * Return: timeout in ms, -1 if none is needed
+ */
+int heatmap_timeout(void)
+{
+	long remaining;
+
+	if (!dirty)
+		return -1;
+
+	remaining = HEATMAP_SAVE_INTERVAL - elapsed_ms(&last_save);
+
+	return remaining > 0 ? remaining : 0;
+}
+
+/**
+ * heatmap_tick() - save the heat map, if anything changed for a while
+ */
+void heatmap_tick(void)
+{
+	if (dirty && elapsed_ms(&last_save) >= HEATMAP_SAVE_INTERVAL)
+		heatmap_save();
+}
+
+static void heatmap_dump_buckets(FILE *f, const uint64_t *buckets)
+{
+	const char *sep = "";
+	uint64_t low;
+	int i;
+
+	for (i = 0; i < HEATMAP_BUCKETS; i++) {
+		if (!buckets[i])
+			continue;
+
+		/* Labelled by the lower bound of the bucket */
+		low = i ? 1ULL << (i - 1) : 0;
+		if (low >= 1024 * 1024)
+			fprintf(f, "%s%lluM:", sep, (unsigned long long)(low >> 20));
+		else if (low >= 1024)
+			fprintf(f, "%s%lluK:", sep, (unsigned long long)(low >> 10));
+		else
+			fprintf(f, "%s%llu:", sep, (unsigned long long)low);
+		fprintf(f, "%llu", (unsigned long long)buckets[i]);
+		sep = ",";
+	}
+
+	fprintf(f, "%s", *sep ? " " : "- ");
+}
+
+static int heatmap_compare(const void *a, const void *b)
+{
+	const struct heatmap_file *fa = *(const struct heatmap_file **)a;
+	const struct heatmap_file *fb = *(const struct heatmap_file **)b;
+
+	if (fa->requests != fb->requests)
+		return fa->requests < fb->requests ? 1 : -1;
+
+	return fa->bytes < fb->bytes ? 1 : fa->bytes > fb->bytes ? -1 : 0;
+}
+
+/**
+ * heatmap_dump() - print the heat map, most requested files first
+ * @f:		stream to print to
+ *
+ * The ranges read are shown as a 64th of the file per character, '#' if any
+ * of it was sent. Seek and rsize histograms count requests per power of two.
+ */
+void heatmap_dump(FILE *f)
+{
+	struct heatmap_file *sorted[HEATMAP_MAX_FILES];
+	struct heatmap_file *file;
+	char ranges[HEATMAP_RANGES + 1];
+	unsigned int n = 0;
+	unsigned int i;
+	int j;
+
+	list_for_each_entry(file, &files, node)
+		sorted[n++] = file;
+	qsort(sorted, n, sizeof(sorted[0]), heatmap_compare);
+
+	fprintf(f, "requests nodes bytes size ranges seek rsize file\n");
+	for (i = 0; i < n; i++) {
+		file = sorted[i];
+
+		for (j = 0; j < HEATMAP_RANGES; j++)
+			ranges[j] = file->ranges & (1ULL << j) ? '#' : '.';
+		ranges[HEATMAP_RANGES] = '\0';
+
+		fprintf(f, "%llu %u %llu %zu %s ", (unsigned long long)file->requests,
+			file->nnodes, (unsigned long long)file->bytes, file->size,
+			ranges);
+		heatmap_dump_buckets(f, file->seeks);
+		heatmap_dump_buckets(f, file->rsizes);
+		fprintf(f, "%s\n", file->path);
+	}
+}
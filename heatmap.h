@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __HEATMAP_H__
+#define __HEATMAP_H__
+
+#include <sys/types.h>
+#include <stdio.h>
+
+#ifndef ANDROID
+#define HEATMAP_PATH	"/var/lib/tqftpserv/heatmap"
+#else
+#define HEATMAP_PATH	"/data/vendor/tqftpserv/heatmap"
+#endif
+
+struct heatmap_file;
+
+void heatmap_init(void);
+struct heatmap_file *heatmap_request(const char *path, unsigned int node_id,
+				     off_t seek, size_t rsize, size_t size);
+struct heatmap_file *heatmap_lookup(const char *path);
+void heatmap_read(struct heatmap_file *file, size_t offset, size_t len);
+int heatmap_timeout(void);
+void heatmap_tick(void);
+void heatmap_save(void);
+void heatmap_dump(FILE *f);
+
+#endif
@@ -0,0 +1,385 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+/* Messages queued, at most; a power of two */
+#define LOGGER_RING		128
+#define LOGGER_MSG_MAX		200
+
+/* Repeats of a message logged in each interval, in ms, before dropping them */
+#define LOGGER_BURST		10
+#define LOGGER_INTERVAL		5000
+
+/* Messages tracked for repeats at once; a power of two */
+#define LOGGER_KEYS		64
+
+#define JOURNAL_SOCKET		"/run/systemd/journal/socket"
+
+/*
+ * A slot of the ring, free for the producer at position @seq, or holding a
+ * message for the consumer at position @seq - 1, as in Vyukov's bounded
+ * queue.
+ */
+struct logger_entry {
+	atomic_size_t seq;
+
+	const struct logger_site *site;
+	int level;
+	unsigned int suppressed;
+	char msg[LOGGER_MSG_MAX];
+};
+
+/* Rate limiting state of a message, keyed by its call site and text */
+struct logger_key {
+	_Atomic uint64_t hash;
+	_Atomic uint64_t window;
+	atomic_uint count;
+	atomic_uint suppressed;
+};
+
+int logger_level = LOG_INFO;
+
+static struct logger_key keys[LOGGER_KEYS];
+
+/* Repeats suppressed of messages no longer tracked, reported by the drain */
+static atomic_uint evicted;
+
+static struct logger_entry ring[LOGGER_RING];
+static atomic_size_t ring_tail;
+static atomic_uint dropped;
+
+/* Only accessed by the drain thread, once running */
+static size_t ring_head;
+static int journal_fd = -1;
+
+static pthread_t drain_thread;
+static bool drain_running;
+static atomic_bool drain_sleeping;
+static atomic_bool drain_stop;
+static int drain_efd = -1;
+
+static uint64_t now_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* Send a message to journald, or print it if journald isn't there */
+static void logger_emit(const struct logger_entry *entry)
+{
+	char suffix[48] = "";
+	char buf[LOGGER_MSG_MAX + 192];
+	int n;
+
+	if (entry->suppressed)
+		snprintf(suffix, sizeof(suffix), " (%u repeats suppressed)",
+			 entry->suppressed);
+
+	if (journal_fd >= 0) {
+		n = snprintf(buf, sizeof(buf),
+			     "PRIORITY=%d\nSYSLOG_IDENTIFIER=tqftpserv\n"
+			     "CODE_FILE=%s\nCODE_LINE=%d\nMESSAGE=%s%s\n",
+			     entry->level,
+			     entry->site ? entry->site->file : "",
+			     entry->site ? entry->site->line : 0,
+			     entry->msg, suffix);
+		if (n >= sizeof(buf)) {
+			n = sizeof(buf) - 1;
+			buf[n - 1] = '\n';
+		}
+
+		if (send(journal_fd, buf, n, MSG_NOSIGNAL) >= 0)
+			return;
+	}
+
+	fprintf(stderr, "[TQFTP] %s%s\n", entry->msg, suffix);
+}
+
+static bool logger_pending(void)
+{
+	struct logger_entry *entry = &ring[ring_head % LOGGER_RING];
+
+	return atomic_load_explicit(&entry->seq, memory_order_acquire) == ring_head + 1;
+}
+
+static void *logger_drain(void *data)
+{
+	struct logger_entry entry = {};
+	struct logger_entry *slot;
+	unsigned int n;
+	uint64_t events;
+
+	for (;;) {
+		while (logger_pending()) {
+			slot = &ring[ring_head % LOGGER_RING];
+			logger_emit(slot);
+			atomic_store_explicit(&slot->seq, ring_head + LOGGER_RING,
+					      memory_order_release);
+			ring_head++;
+		}
+
+		n = atomic_exchange_explicit(&dropped, 0, memory_order_relaxed);
+		if (n) {
+			entry.level = LOG_WARNING;
+			snprintf(entry.msg, sizeof(entry.msg),
+				 "%u messages dropped, logging too fast", n);
+			logger_emit(&entry);
+		}
+
+		n = atomic_exchange_explicit(&evicted, 0, memory_order_relaxed);
+		if (n) {
+			entry.level = LOG_WARNING;
+			snprintf(entry.msg, sizeof(entry.msg),
+				 "%u repeated messages suppressed", n);
+			logger_emit(&entry);
+		}
+
+		if (atomic_load(&drain_stop))
+			break;
+
+		/* Pairs with the fence in logger_write() */
+		atomic_store(&drain_sleeping, true);
+		atomic_thread_fence(memory_order_seq_cst);
+		if (logger_pending()) {
+			atomic_store(&drain_sleeping, false);
+			continue;
+		}
+
+		if (read(drain_efd, &events, sizeof(events)) < 0)
+			usleep(10000);
+	}
+
+	return NULL;
+}
+
+static int logger_wake(void)
+{
+	const uint64_t one = 1;
+
+	return write(drain_efd, &one, sizeof(one)) < 0 ? -1 : 0;
+}
+
+static void logger_exit(void)
+{
+	atomic_store(&drain_stop, true);
+	if (logger_wake() < 0)
+		return;
+
+	pthread_join(drain_thread, NULL);
+	drain_running = false;
+}
+
+/**
+ * logger_init() - start sending messages to journald from a background thread
+ *
+ * Messages logged before are printed as they are. The thread sends the
+ * remaining messages at exit.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int logger_init(void)
+{
+	struct sockaddr_un addr = {
+		.sun_family = AF_UNIX,
+		.sun_path = JOURNAL_SOCKET,
+	};
+	sigset_t mask;
+	sigset_t old;
+	int ret;
+	int i;
+
+	for (i = 0; i < LOGGER_RING; i++)
+		atomic_init(&ring[i].seq, i);
+
+	drain_efd = eventfd(0, EFD_CLOEXEC);
+	if (drain_efd < 0)
+		return -1;
+
+	journal_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (journal_fd >= 0 &&
+	    connect(journal_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(journal_fd);
+		journal_fd = -1;
+	}
+
+	/* Leave signals to the main loop */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, &old);
+	ret = pthread_create(&drain_thread, NULL, logger_drain, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (ret) {
+		close(drain_efd);
+		drain_efd = -1;
+		return -1;
+	}
+
+	drain_running = true;
+	atexit(logger_exit);
+
+	return 0;
+}
+
+/**
+ * logger_set_level() - set the most verbose level of messages logged
+ * @level:	syslog level, up to TQFTP_LOG_LEVEL being effective
+ */
+void logger_set_level(int level)
+{
+	logger_level = level;
+}
+
+static uint64_t logger_hash(const struct logger_site *site, const char *msg)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL ^ (uintptr_t)site;
+
+	for (; *msg; msg++) {
+		hash ^= (unsigned char)*msg;
+		hash *= 0x100000001b3ULL;
+	}
+
+	/* 0 marks a free key */
+	return hash ? hash : 1;
+}
+
+/*
+ * Return: whether @msg may be logged now, also setting @suppressed repeats.
+ * Only repeats of the same message from the same site count towards the
+ * limit; messages differing in any of their arguments are logged.
+ */
+static bool logger_allow(const struct logger_site *site, const char *msg,
+			 unsigned int *suppressed)
+{
+	uint64_t hash = logger_hash(site, msg);
+	struct logger_key *key = &keys[hash % LOGGER_KEYS];
+	uint64_t now = now_ms();
+	uint64_t window;
+	uint64_t old;
+
+	old = atomic_load(&key->hash);
+	window = atomic_load(&key->window);
+	if (old != hash) {
+		/* The key is held by another message for now, not a repeat */
+		if (old && now - window < LOGGER_INTERVAL)
+			return true;
+		if (!atomic_compare_exchange_strong(&key->hash, &old, hash))
+			return true;
+
+		atomic_store(&key->window, now);
+		atomic_store(&key->count, 0);
+		atomic_fetch_add(&evicted, atomic_exchange(&key->suppressed, 0));
+	} else if (now - window >= LOGGER_INTERVAL &&
+		   atomic_compare_exchange_strong(&key->window, &window, now)) {
+		atomic_store(&key->count, 0);
+		*suppressed = atomic_exchange(&key->suppressed, 0);
+	}
+
+	if (atomic_fetch_add(&key->count, 1) >= LOGGER_BURST) {
+		atomic_fetch_add(&key->suppressed, 1);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Formatted by the producer rather than the drain thread, as arguments such as
+ * file names and remote strings don't outlive the call, and as repeats are
+ * told apart by their text.
+ */
+static void logger_format(char *msg, const char *fmt, va_list ap)
+{
+	char *p;
+
+	vsnprintf(msg, LOGGER_MSG_MAX, fmt, ap);
+
+	/* Keep each message on a line, whatever remotes send */
+	for (p = msg; *p; p++) {
+		if ((unsigned char)*p < 0x20)
+			*p = ' ';
+	}
+}
+
+/**
+ * logger_write() - log a message, through pr_log() and friends
+ * @site:	call site, for rate limiting and passed on to journald
+ * @level:	syslog level
+ * @fmt:	printf-style format of the message
+ *
+ * Never blocks: the message is dropped if the queue is full.
+ */
+void logger_write(const struct logger_site *site, int level, const char *fmt, ...)
+{
+	struct logger_entry local = {};
+	struct logger_entry *entry;
+	unsigned int suppressed = 0;
+	char msg[LOGGER_MSG_MAX];
+	size_t pos = 0;
+	size_t seq;
+	va_list ap;
+
+	va_start(ap, fmt);
+	logger_format(msg, fmt, ap);
+	va_end(ap);
+
+	if (!logger_allow(site, msg, &suppressed))
+		return;
+
+	if (!drain_running) {
+		entry = &local;
+	} else {
+		pos = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+		for (;;) {
+			entry = &ring[pos % LOGGER_RING];
+			seq = atomic_load_explicit(&entry->seq, memory_order_acquire);
+			if (seq == pos) {
+				if (atomic_compare_exchange_weak_explicit(&ring_tail, &pos, pos + 1,
+									  memory_order_relaxed,
+									  memory_order_relaxed))
+					break;
+			} else if ((intptr_t)(seq - pos) < 0) {
+				atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+				return;
+			} else {
+				pos = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+			}
+		}
+	}
+
+	entry->site = site;
+	entry->level = level;
+	entry->suppressed = suppressed;
+	memcpy(entry->msg, msg, sizeof(entry->msg));
+
+	if (entry == &local) {
+		logger_emit(entry);
+		return;
+	}
+
+	atomic_store_explicit(&entry->seq, pos + 1, memory_order_release);
+
+	/* Pairs with the fence in logger_drain() */
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&drain_sleeping, memory_order_relaxed) &&
+	    atomic_exchange(&drain_sleeping, false))
+		logger_wake();
+}
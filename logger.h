@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __LOGGER_H__
+#define __LOGGER_H__
+
+#include <syslog.h>
+
+#include "profile.h"
+
+/* Call site of a message, passed on to journald */
+struct logger_site {
+	const char *file;
+	int line;
+};
+
+/* Messages above this level are still compiled in, but dropped at runtime */
+extern int logger_level;
+
+/*
+ * Log a message, as a syslog level. Messages above TQFTP_LOG_LEVEL are
+ * compiled out; others are queued without blocking, for a background thread
+ * to send to journald. Repeats of a message from a call site are rate limited.
+ */
+#define pr_log(level, fmt, ...)						\
+	do {								\
+		static const struct logger_site __site = {			\
+			.file = __FILE__,				\
+			.line = __LINE__,				\
+		};							\
+		if ((level) <= TQFTP_LOG_LEVEL && (level) <= logger_level) \
+			logger_write(&__site, (level), fmt, ##__VA_ARGS__); \
+	} while (0)
+
+#define pr_err(fmt, ...)	pr_log(LOG_ERR, fmt, ##__VA_ARGS__)
+#define pr_warn(fmt, ...)	pr_log(LOG_WARNING, fmt, ##__VA_ARGS__)
+#define pr_info(fmt, ...)	pr_log(LOG_INFO, fmt, ##__VA_ARGS__)
+#define pr_debug(fmt, ...)	pr_log(LOG_DEBUG, fmt, ##__VA_ARGS__)
+
+int logger_init(void);
+void logger_set_level(int level);
+void logger_write(const struct logger_site *site, int level, const char *fmt, ...)
+	__attribute__((format(printf, 3, 4)));
+
+#endif
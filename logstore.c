@@ -0,0 +1,721 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+/* For memfd_create and O_TMPFILE */
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "list.h"
+#include "logger.h"
+#include "logstore.h"
+
+#define LOGSTORE_NAME		"readwrite.log"
+#define LOGSTORE_TMP_NAME	"readwrite.log.tmp"
+#define LOGSTORE_MAGIC		0x4c465154	/* "TQFL" */
+
+/* Don't bother compacting until at least this much of the log is garbage */
+#define LOGSTORE_COMPACT_MIN	(1024 * 1024)
+
+/* Files are copied into the log in chunks of this size */
+#define LOGSTORE_COPY_CHUNK	(64 * 1024)
+
+/*
+ * On-disk record, followed by name_len bytes of file name and data_len bytes
+ * of file content. The crc covers name_len, data_len, name and data.
+ */
+struct logstore_record {
+	uint32_t magic;
+	uint32_t crc;
+	uint32_t name_len;
+	uint32_t data_len;
+};
+
+/* Latest version of a file in the log */
+struct logstore_entry {
+	struct list_head node;
+
+	char *name;
+	off_t offset;
+	size_t size;
+};
+
+/*
+ * File handed out for writing, spooled to an unnamed file next to the log
+ * and committed to the log once released
+ */
+struct logstore_pending {
+	struct list_head node;
+
+	char *name;
+	int fd;
+};
+
+static struct list_head entries = LIST_INIT(entries);
+static struct list_head pending = LIST_INIT(pending);
+
+/*
+ * Released files, committed in order by the commit thread. The lock covers
+ * this list, the index and log_fd, which the commit thread alone changes.
+ */
+static struct list_head commits = LIST_INIT(commits);
+static pthread_mutex_t logstore_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t commit_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t commit_thread;
+static bool commit_running;
+static bool commit_stop;
+
+static uint32_t crc_table[256];
+
+static int dir_fd = -1;
+static int log_fd = -1;
+static off_t log_size;
+static size_t live_bytes;
+
+static void crc32_init(void)
+{
+	uint32_t c;
+	int i;
+	int j;
+
+	for (i = 0; i < 256; i++) {
+		c = i;
+		for (j = 0; j < 8; j++)
+			c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		crc_table[i] = c;
+	}
+}
+
+static uint32_t crc32_update(uint32_t crc, const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+
+	crc = ~crc;
+	while (len--)
+		crc = crc_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+static uint32_t record_crc(const struct logstore_record *rec,
+			   const char *name, const void *data)
+{
+	uint32_t crc;
+
+	crc = crc32_update(0, &rec->name_len, sizeof(rec->name_len));
+	crc = crc32_update(crc, &rec->data_len, sizeof(rec->data_len));
+	crc = crc32_update(crc, name, rec->name_len);
+
+	return crc32_update(crc, data, rec->data_len);
+}
+
+static struct logstore_entry *logstore_find(const char *name)
+{
+	struct logstore_entry *entry;
+
+	list_for_each_entry(entry, &entries, node) {
+		if (!strcmp(entry->name, name))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/* Return: 0 on success, -1 if out of memory */
+static int logstore_update(const char *name, off_t offset, size_t size)
+{
+	struct logstore_entry *entry;
+
+	entry = logstore_find(name);
+	if (entry) {
+		live_bytes -= sizeof(struct logstore_record) +
+			      strlen(entry->name) + entry->size;
+	} else {
+		entry = calloc(1, sizeof(*entry));
+		if (!entry)
+			return -1;
+
+		entry->name = strdup(name);
+		if (!entry->name) {
+			free(entry);
+			return -1;
+		}
+		list_add(&entries, &entry->node);
+	}
+
+	entry->offset = offset;
+	entry->size = size;
+
+	live_bytes += sizeof(struct logstore_record) + strlen(name) + size;
+
+	return 0;
+}
+
+static int write_all(int fd, const void *buf, size_t len, off_t offset)
+{
+	const char *p = buf;
+	ssize_t n;
+
+	while (len) {
+		n = pwrite(fd, p, len, offset);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		p += n;
+		offset += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int read_all(int fd, void *buf, size_t len, off_t offset)
+{
+	char *p = buf;
+	ssize_t n;
+
+	while (len) {
+		n = pread(fd, p, len, offset);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+
+		p += n;
+		offset += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/**
+ * logstore_append() - append a file to the log, as a record
+ * @fd:		log to append to
+ * @offset:	offset of the end of the log, updated on success
+ * @name:	name of the file
+ * @src:	fd to read the content of the file from
+ * @src_offset:	offset of the content in @src
+ * @size:	size of the content
+ *
+ * The content is copied a chunk at a time, and the header written last so
+ * that the record isn't valid until complete.
+ *
+ * Return: offset of the file content in the log on success, -1 on error
+ */
+static off_t logstore_append(int fd, off_t *offset, const char *name,
+			     int src, off_t src_offset, size_t size)
+{
+	struct logstore_record rec;
+	size_t name_len = strlen(name);
+	off_t data_offset;
+	size_t done;
+	size_t len;
+	char *buf;
+
+	buf = malloc(LOGSTORE_COPY_CHUNK);
+	if (!buf)
+		return -1;
+
+	rec.magic = LOGSTORE_MAGIC;
+	rec.name_len = name_len;
+	rec.data_len = size;
+	rec.crc = crc32_update(0, &rec.name_len, sizeof(rec.name_len));
+	rec.crc = crc32_update(rec.crc, &rec.data_len, sizeof(rec.data_len));
+	rec.crc = crc32_update(rec.crc, name, name_len);
+
+	data_offset = *offset + sizeof(rec) + name_len;
+
+	for (done = 0; done < size; done += len) {
+		len = size - done;
+		if (len > LOGSTORE_COPY_CHUNK)
+			len = LOGSTORE_COPY_CHUNK;
+
+		if (read_all(src, buf, len, src_offset + done) < 0 ||
+		    write_all(fd, buf, len, data_offset + done) < 0) {
+			free(buf);
+			return -1;
+		}
+		rec.crc = crc32_update(rec.crc, buf, len);
+	}
+	free(buf);
+
+	if (write_all(fd, name, name_len, *offset + sizeof(rec)) < 0 ||
+	    write_all(fd, &rec, sizeof(rec), *offset) < 0)
+		return -1;
+
+	*offset = data_offset + size;
+
+	return data_offset;
+}
+
+/**
+ * logstore_replay() - rebuild the index from the log
+ *
+ * Records are validated one by one, anything following the first truncated
+ * or corrupt record is assumed to be the result of a crash mid-append and is
+ * cut off, so that subsequent appends land on a valid record boundary.
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int logstore_replay(void)
+{
+	struct logstore_record rec;
+	struct stat sb;
+	char *name;
+	void *data;
+	off_t offset = 0;
+
+	if (fstat(log_fd, &sb) < 0)
+		return -1;
+
+	while (offset + (off_t)sizeof(rec) <= sb.st_size) {
+		if (read_all(log_fd, &rec, sizeof(rec), offset) < 0)
+			break;
+
+		if (rec.magic != LOGSTORE_MAGIC || !rec.name_len ||
+		    offset + (off_t)sizeof(rec) + rec.name_len + rec.data_len > sb.st_size)
+			break;
+
+		name = malloc(rec.name_len + 1);
+		data = malloc(rec.data_len ? rec.data_len : 1);
+		if (!name || !data ||
+		    read_all(log_fd, name, rec.name_len, offset + sizeof(rec)) < 0 ||
+		    read_all(log_fd, data, rec.data_len, offset + sizeof(rec) + rec.name_len) < 0 ||
+		    record_crc(&rec, name, data) != rec.crc) {
+			free(name);
+			free(data);
+			break;
+		}
+		name[rec.name_len] = '\0';
+
+		if (logstore_update(name, offset + sizeof(rec) + rec.name_len,
+				    rec.data_len) < 0) {
+			free(name);
+			free(data);
+			return -1;
+		}
+		offset += sizeof(rec) + rec.name_len + rec.data_len;
+
+		free(name);
+		free(data);
+	}
+
+	if (offset != sb.st_size) {
+		pr_warn("discarding %ld bytes of incomplete log",
+			(long)(sb.st_size - offset));
+		if (ftruncate(log_fd, offset) < 0)
+			return -1;
+	}
+
+	log_size = offset;
+
+	return 0;
+}
+
+/**
+ * logstore_compact() - rewrite the log with only the latest file versions
+ *
+ * The compacted log is written to a temporary file and atomically renamed
+ * over the old one, so a crash at any point leaves one complete log behind.
+ * Called from the commit thread, which alone changes the index, so the index
+ * is only locked to switch over to the new log.
+ */
+static void logstore_compact(void)
+{
+	struct logstore_entry *entry;
+	off_t offset = 0;
+	off_t data_offset;
+	int fd;
+
+	fd = openat(dir_fd, LOGSTORE_TMP_NAME, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		pr_err("failed to create compacted log: %s", strerror(errno));
+		return;
+	}
+
+	list_for_each_entry(entry, &entries, node) {
+		if (logstore_append(fd, &offset, entry->name, log_fd,
+				    entry->offset, entry->size) < 0) {
+			pr_err("failed to compact log: %s", strerror(errno));
+			goto err;
+		}
+	}
+
+	if (fdatasync(fd) < 0 ||
+	    renameat(dir_fd, LOGSTORE_TMP_NAME, dir_fd, LOGSTORE_NAME) < 0) {
+		pr_err("failed to replace log: %s", strerror(errno));
+		goto err;
+	}
+	fsync(dir_fd);
+
+	/* Offsets are stable in the new log, as entries were appended in order */
+	pthread_mutex_lock(&logstore_lock);
+	offset = 0;
+	list_for_each_entry(entry, &entries, node) {
+		data_offset = offset + sizeof(struct logstore_record) + strlen(entry->name);
+		entry->offset = data_offset;
+		offset = data_offset + entry->size;
+	}
+
+	close(log_fd);
+	log_fd = fd;
+	log_size = offset;
+	pthread_mutex_unlock(&logstore_lock);
+
+	return;
+
+err:
+	close(fd);
+	unlinkat(dir_fd, LOGSTORE_TMP_NAME, 0);
+}
+
+/**
+ * logstore_commit() - append a released file to the log
+ * @pend:	file released by logstore_release()
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int logstore_commit(struct logstore_pending *pend)
+{
+	struct stat sb;
+	off_t offset = log_size;
+	off_t data_offset;
+	int ret;
+
+	if (fstat(pend->fd, &sb) < 0)
+		return -1;
+
+	data_offset = logstore_append(log_fd, &offset, pend->name, pend->fd, 0,
+				      sb.st_size);
+	if (data_offset < 0 || fdatasync(log_fd) < 0) {
+		pr_err("failed to append %s to log: %s", pend->name,
+		       strerror(errno));
+		/* Leave log_size alone, the next append overwrites the tail */
+		return -1;
+	}
+
+	pthread_mutex_lock(&logstore_lock);
+	log_size = offset;
+	ret = logstore_update(pend->name, data_offset, sb.st_size);
+	pthread_mutex_unlock(&logstore_lock);
+	if (ret < 0) {
+		/* In the log nonetheless, found again on the next replay */
+		pr_err("failed to index %s, out of memory", pend->name);
+		return -1;
+	}
+
+	if (log_size - live_bytes > LOGSTORE_COMPACT_MIN &&
+	    log_size - live_bytes > live_bytes)
+		logstore_compact();
+
+	return 0;
+}
+
+static void logstore_pending_free(struct logstore_pending *pend)
+{
+	close(pend->fd);
+	free(pend->name);
+	free(pend);
+}
+
+/*
+ * Commits released files, so that the main loop never waits for the log to
+ * be synced or compacted. Files are kept on the list until committed, for
+ * logstore_open() to find the version not in the log yet.
+ */
+static void *logstore_commit_thread(void *data)
+{
+	struct logstore_pending *pend;
+
+	pthread_mutex_lock(&logstore_lock);
+	for (;;) {
+		while (list_empty(&commits) && !commit_stop)
+			pthread_cond_wait(&commit_cond, &logstore_lock);
+		if (list_empty(&commits))
+			break;
+
+		pend = list_entry_first(&commits, struct logstore_pending, node);
+		pthread_mutex_unlock(&logstore_lock);
+
+		logstore_commit(pend);
+
+		pthread_mutex_lock(&logstore_lock);
+		list_del(&pend->node);
+		logstore_pending_free(pend);
+		pthread_cond_broadcast(&idle_cond);
+	}
+	pthread_mutex_unlock(&logstore_lock);
+
+	return NULL;
+}
+
+/* Files released before exiting are committed still */
+static void logstore_exit(void)
+{
+	pthread_mutex_lock(&logstore_lock);
+	commit_stop = true;
+	pthread_cond_signal(&commit_cond);
+	pthread_mutex_unlock(&logstore_lock);
+
+	pthread_join(commit_thread, NULL);
+	commit_running = false;
+}
+
+/**
+ * logstore_init() - open, or create, the log in @dir and replay it
+ * @dir:	directory holding the log
+ *
+ * Return: 0 on success, -1 on error
+ */
+int logstore_init(const char *dir)
+{
+	sigset_t mask;
+	sigset_t old;
+	int ret;
+
+	crc32_init();
+
+	dir_fd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (dir_fd < 0) {
+		pr_err("failed to open %s: %s", dir, strerror(errno));
+		return -1;
+	}
+
+	log_fd = openat(dir_fd, LOGSTORE_NAME, O_RDWR | O_CREAT, 0600);
+	if (log_fd < 0) {
+		pr_err("failed to open log: %s", strerror(errno));
+		goto err;
+	}
+
+	if (logstore_replay() < 0) {
+		pr_err("failed to replay log: %s", strerror(errno));
+		goto err;
+	}
+
+	/* Leave signals to the main loop */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, &old);
+	ret = pthread_create(&commit_thread, NULL, logstore_commit_thread, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (ret) {
+		pr_err("failed to start commit thread: %s", strerror(ret));
+		goto err;
+	}
+
+	commit_running = true;
+	atexit(logstore_exit);
+
+	return 0;
+
+err:
+	if (log_fd >= 0)
+		close(log_fd);
+	close(dir_fd);
+	log_fd = dir_fd = -1;
+	return -1;
+}
+
+/*
+ * Copy the latest version of @file into @fd, from the file waiting to be
+ * committed if any, from the log otherwise. Called with the lock held.
+ *
+ * Return: 0 on success, 1 if the file doesn't exist, -1 on error
+ */
+static int logstore_read(const char *file, int fd)
+{
+	struct logstore_pending *latest = NULL;
+	struct logstore_pending *pend;
+	struct logstore_entry *entry;
+	struct stat sb;
+	off_t done;
+	ssize_t n;
+	char *buf;
+	int src;
+	size_t size;
+	off_t offset;
+
+	list_for_each_entry(pend, &commits, node) {
+		if (!strcmp(pend->name, file))
+			latest = pend;
+	}
+
+	if (latest) {
+		if (fstat(latest->fd, &sb) < 0)
+			return -1;
+		src = latest->fd;
+		offset = 0;
+		size = sb.st_size;
+	} else {
+		entry = logstore_find(file);
+		if (!entry)
+			return 1;
+		src = log_fd;
+		offset = entry->offset;
+		size = entry->size;
+	}
+
+	if (fd < 0 || !size)
+		return 0;
+
+	buf = malloc(LOGSTORE_COPY_CHUNK);
+	if (!buf)
+		return -1;
+
+	for (done = 0; done < size; done += n) {
+		n = size - done;
+		if (n > LOGSTORE_COPY_CHUNK)
+			n = LOGSTORE_COPY_CHUNK;
+
+		if (read_all(src, buf, n, offset + done) < 0 ||
+		    write_all(fd, buf, n, done) < 0) {
+			free(buf);
+			return -1;
+		}
+	}
+	free(buf);
+
+	return 0;
+}
+
+/* Unnamed file next to the log, so that uploads are written back as they come */
+static int logstore_spool(const char *file)
+{
+	int fd;
+
+	fd = openat(dir_fd, ".", O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+	if (fd < 0 && (errno == EOPNOTSUPP || errno == EISDIR))
+		fd = memfd_create(file, MFD_CLOEXEC);
+
+	return fd;
+}
+
+/**
+ * logstore_open() - open a file residing in the log
+ * @file:	name of the file, with /readwrite/ stripped
+ * @flags:	flags as would be passed to open(2)
+ *
+ * Files opened for reading are an in-memory copy of the latest version of
+ * the file. Files opened for writing are spooled to disk as written, and the
+ * content is appended to the log as a new version, by the commit thread, once
+ * the fd is passed to logstore_release().
+ *
+ * Return: opened fd on success, -1 otherwise
+ */
+int logstore_open(const char *file, int flags)
+{
+	struct logstore_pending *pend;
+	bool write = (flags & O_ACCMODE) != O_RDONLY;
+	int ret;
+	int fd;
+
+	fd = write ? logstore_spool(file) : memfd_create(file, MFD_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	pthread_mutex_lock(&logstore_lock);
+	ret = logstore_read(file, flags & O_TRUNC ? -1 : fd);
+	pthread_mutex_unlock(&logstore_lock);
+	if (ret < 0 || (ret > 0 && !(flags & O_CREAT))) {
+		close(fd);
+		errno = ret < 0 ? EIO : ENOENT;
+		return -1;
+	}
+
+	if (write) {
+		pend = calloc(1, sizeof(*pend));
+		if (pend)
+			pend->name = strdup(file);
+		if (!pend || !pend->name) {
+			free(pend);
+			close(fd);
+			errno = ENOMEM;
+			return -1;
+		}
+		pend->fd = fd;
+		list_add(&pending, &pend->node);
+	}
+
+	return fd;
+}
+
+/**
+ * logstore_release() - release an fd returned by logstore_open()
+ * @fd:		fd to release
+ *
+ * Files opened for writing are queued to be committed to the log, @fd being
+ * closed once committed.
+ *
+ * Return: true if @fd was opened for writing by logstore_open(), and is now
+ * owned by the store
+ */
+bool logstore_release(int fd)
+{
+	struct logstore_pending *pend;
+
+	list_for_each_entry(pend, &pending, node) {
+		if (pend->fd == fd) {
+			list_del(&pend->node);
+
+			pthread_mutex_lock(&logstore_lock);
+			list_add(&commits, &pend->node);
+			pthread_cond_signal(&commit_cond);
+			pthread_mutex_unlock(&logstore_lock);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * logstore_sync() - wait for released files to be committed to the log
+ */
+void logstore_sync(void)
+{
+	pthread_mutex_lock(&logstore_lock);
+	while (commit_running && !list_empty(&commits))
+		pthread_cond_wait(&idle_cond, &logstore_lock);
+	pthread_mutex_unlock(&logstore_lock);
+}
+
+/**
+ * logstore_adopt() - take over a file opened for writing by another process
+ * @fd:		fd returned by logstore_open() in the other process
+ * @file:	name of the file in the store
+ *
+ * The file is committed to the log by logstore_release(), as if opened here.
+ */
+void logstore_adopt(int fd, const char *file)
+{
+	struct logstore_pending *pend;
+
+	pend = calloc(1, sizeof(*pend));
+	if (pend)
+		pend->name = strdup(file);
+	if (!pend || !pend->name) {
+		pr_err("unable to adopt %s, dropping it", file);
+		free(pend);
+		return;
+	}
+
+	pend->fd = fd;
+	list_add(&pending, &pend->node);
+}
@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __LOGSTORE_H__
+#define __LOGSTORE_H__
+
+#include <stdbool.h>
+
+int logstore_init(const char *dir);
+int logstore_open(const char *file, int flags);
+bool logstore_release(int fd);
+void logstore_sync(void);
+void logstore_adopt(int fd, const char *file);
+
+#endif
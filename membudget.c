@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include <err.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "membudget.h"
+
+/* Trigger when tasks stalled on memory for 150ms within any 1s window */
+#define PSI_TRIGGER		"some 150000 1000000"
+#define PSI_SYSTEM		"/proc/pressure/memory"
+
+/* Relax one level after this long, in ms, without pressure */
+#define RELAX_INTERVAL		30000
+
+#define MAX_SHRINKERS		8
+
+static const char * const subsys_names[MEMBUDGET_NR_SUBSYS] = {
+	[MEMBUDGET_CACHE_FILES] = "cache-files",
+	[MEMBUDGET_CACHE_BLOCKS] = "cache-blocks",
+	[MEMBUDGET_DECOMPRESS] = "decompress",
+	[MEMBUDGET_TRANSFERS] = "transfers",
+	[MEMBUDGET_PREFETCH] = "prefetch",
+};
+
+static atomic_size_t usage[MEMBUDGET_NR_SUBSYS];
+
+static membudget_shrink_fn shrinkers[MAX_SHRINKERS];
+static unsigned int nshrinkers;
+
+static unsigned int pressure_level;
+static struct timespec last_event;
+
+static long elapsed_ms(const struct timespec *since)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - since->tv_sec) * 1000 +
+	       (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+/**
+ * membudget_account() - account memory allocated, or freed, by a subsystem
+ * @subsys:	subsystem owning the memory
+ * @delta:	number of bytes allocated, negative when freed
+ */
+void membudget_account(enum membudget_subsys subsys, ssize_t delta)
+{
+	atomic_fetch_add_explicit(&usage[subsys], delta, memory_order_relaxed);
+}
+
+size_t membudget_usage(enum membudget_subsys subsys)
+{
+	return atomic_load_explicit(&usage[subsys], memory_order_relaxed);
+}
+
+const char *membudget_name(enum membudget_subsys subsys)
+{
+	return subsys_names[subsys];
+}
+
+/**
+ * membudget_register() - register a callback reacting to memory pressure
+ * @fn:		called with the new pressure level whenever it changes
+ *
+ * Level 0 means no pressure, subsystems are expected to give back memory in
+ * proportion to the level; the cheapest to rebuild at the lowest levels.
+ */
+void membudget_register(membudget_shrink_fn fn)
+{
+	if (nshrinkers < MAX_SHRINKERS)
+		shrinkers[nshrinkers++] = fn;
+}
+
+static void membudget_set_level(unsigned int level)
+{
+	unsigned int i;
+
+	if (level == pressure_level)
+		return;
+
+	pressure_level = level;
+	for (i = 0; i < nshrinkers; i++)
+		shrinkers[i](level);
+
+	pr_info("memory pressure level %u", level);
+	for (i = 0; i < MEMBUDGET_NR_SUBSYS; i++)
+		pr_info("  %-12s %zu bytes", subsys_names[i], membudget_usage(i));
+}
+
+/* Path of the cgroup's memory.pressure, if running in a cgroup v2 */
+static int cgroup_pressure_path(char *path, size_t len)
+{
+	char line[PATH_MAX];
+	int ret = -1;
+	FILE *f;
+
+	f = fopen("/proc/self/cgroup", "r");
+	if (!f)
+		return -1;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (strncmp(line, "0::", 3))
+			continue;
+
+		line[strcspn(line, "\n")] = '\0';
+		if (snprintf(path, len, "/sys/fs/cgroup%s/memory.pressure",
+			     line + 3) < len)
+			ret = 0;
+		break;
+	}
+
+	fclose(f);
+
+	return ret;
+}
+
+static int psi_open(const char *path)
+{
+	int fd;
+
+	fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	if (write(fd, PSI_TRIGGER, strlen(PSI_TRIGGER) + 1) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/**
+ * membudget_init() - set up a memory pressure trigger
+ *
+ * The trigger is set on the service's cgroup if possible, as that's where
+ * the limits applying to us live, or system wide otherwise.
+ *
+ * Return: fd to wait for POLLPRI on, -1 if pressure information is unavailable
+ */
+int membudget_init(void)
+{
+	char path[PATH_MAX];
+	int fd = -1;
+
+	if (!cgroup_pressure_path(path, sizeof(path)))
+		fd = psi_open(path);
+	if (fd < 0)
+		fd = psi_open(PSI_SYSTEM);
+	if (fd < 0)
+		warnx("memory pressure information unavailable");
+
+	return fd;
+}
+
+/**
+ * membudget_handle() - the pressure trigger fired, shrink one more level
+ */
+void membudget_handle(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &last_event);
+
+	if (pressure_level < MEMBUDGET_MAX_LEVEL)
+		membudget_set_level(pressure_level + 1);
+}
+
+/**
+ * membudget_timeout() - time until membudget_tick() needs to be called
+ *
+ * Return: timeout in ms, -1 if none is needed
+ */
+int membudget_timeout(void)
+{
+	long remaining;
+
+	if (!pressure_level)
+		return -1;
+
+	remaining = RELAX_INTERVAL - elapsed_ms(&last_event);
+
+	return remaining > 0 ? remaining : 0;
+}
+
+/**
+ * membudget_tick() - grow back one level, once pressure has cleared for a while
+ */
+void membudget_tick(void)
+{
+	if (!pressure_level || elapsed_ms(&last_event) < RELAX_INTERVAL)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &last_event);
+	membudget_set_level(pressure_level - 1);
+}
+
+void membudget_dump(FILE *f)
+{
+	int i;
+
+	for (i = 0; i < MEMBUDGET_NR_SUBSYS; i++)
+		fprintf(f, "[TQFTP]   %-12s %zu bytes\n", subsys_names[i],
+			membudget_usage(i));
+}
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __MEMBUDGET_H__
+#define __MEMBUDGET_H__
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#define MEMBUDGET_MAX_LEVEL	4
+
+enum membudget_subsys {
+	MEMBUDGET_CACHE_FILES,
+	MEMBUDGET_CACHE_BLOCKS,
+	MEMBUDGET_DECOMPRESS,
+	MEMBUDGET_TRANSFERS,
+	MEMBUDGET_PREFETCH,
+	MEMBUDGET_NR_SUBSYS,
+};
+
+typedef void (*membudget_shrink_fn)(unsigned int level);
+
+void membudget_account(enum membudget_subsys subsys, ssize_t delta);
+size_t membudget_usage(enum membudget_subsys subsys);
+const char *membudget_name(enum membudget_subsys subsys);
+void membudget_register(membudget_shrink_fn fn);
+int membudget_init(void);
+void membudget_handle(void);
+int membudget_timeout(void);
+void membudget_tick(void);
+void membudget_dump(FILE *f);
+
+#endif
@@ -0,0 +1,241 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include <sys/mman.h>
+#include <err.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+/* How often the metrics file is updated, while there is activity */
+#define PUBLISH_INTERVAL	1000
+
+static const char * const counter_names[METRICS_NR_COUNTERS] = {
+	[METRICS_RRQ] = "rrq",
+	[METRICS_WRQ] = "wrq",
+	[METRICS_BYTES_SENT] = "bytes-sent",
+	[METRICS_BYTES_RECEIVED] = "bytes-received",
+	[METRICS_BLOCKS_SENT] = "blocks-sent",
+	[METRICS_BLOCKS_RECEIVED] = "blocks-received",
+	[METRICS_RETRANSMITS] = "retransmits",
+	[METRICS_CACHE_HITS] = "cache-hits",
+	[METRICS_CACHE_MISSES] = "cache-misses",
+	[METRICS_SYSCALLS] = "syscalls",
+	[METRICS_ERRORS + 0] = "error-undefined",
+	[METRICS_ERRORS + 1] = "error-not-found",
+	[METRICS_ERRORS + 2] = "error-access",
+	[METRICS_ERRORS + 3] = "error-disk-full",
+	[METRICS_ERRORS + 4] = "error-illegal-op",
+	[METRICS_ERRORS + 5] = "error-unknown-tid",
+	[METRICS_ERRORS + 6] = "error-file-exists",
+	[METRICS_ERRORS + 7] = "error-no-user",
+	[METRICS_ERRORS + 8] = "error-option",
+};
+
+static const char * const histogram_names[METRICS_NR_HISTOGRAMS] = {
+	[METRICS_OPEN] = "open-us",
+	[METRICS_RESOLVE] = "resolve-us",
+	[METRICS_DECOMPRESS] = "decompress-us",
+};
+
+/*
+ * Updated from any thread, published to the metrics file by the main loop so
+ * that readers don't contend with the hot path
+ */
+static _Atomic uint64_t counters[METRICS_NR_COUNTERS];
+static _Atomic uint64_t histograms[METRICS_NR_HISTOGRAMS][METRICS_BUCKETS];
+static atomic_bool dirty;
+
+static struct metrics_page *page;
+static struct timespec last_publish;
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static long elapsed_ms(const struct timespec *since)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - since->tv_sec) * 1000 +
+	       (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+/**
+ * metrics_init() - create the metrics file
+ *
+ * The file is created under a temporary name and renamed once filled in, so
+ * readers never see a partial header. Metrics are still counted if this
+ * fails, only not published.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int metrics_init(void)
+{
+	const char *tmp = METRICS_PATH ".tmp";
+	void *ptr;
+	int fd;
+	int i;
+
+	fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		warn("failed to create %s", tmp);
+		return -1;
+	}
+
+	if (ftruncate(fd, sizeof(*page)) < 0) {
+		warn("failed to size %s", tmp);
+		goto err_unlink;
+	}
+
+	ptr = mmap(NULL, sizeof(*page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ptr == MAP_FAILED) {
+		warn("failed to map %s", tmp);
+		goto err_unlink;
+	}
+	page = ptr;
+
+	page->magic = METRICS_MAGIC;
+	page->version = METRICS_VERSION;
+	page->ncounters = METRICS_NR_COUNTERS;
+	page->nhistograms = METRICS_NR_HISTOGRAMS;
+	page->nbuckets = METRICS_BUCKETS;
+	atomic_store_explicit(&page->started, now_ns(), memory_order_relaxed);
+
+	for (i = 0; i < METRICS_NR_COUNTERS; i++)
+		strncpy(page->counter_names[i], counter_names[i], METRICS_NAME_MAX - 1);
+	for (i = 0; i < METRICS_NR_HISTOGRAMS; i++)
+		strncpy(page->histogram_names[i], histogram_names[i], METRICS_NAME_MAX - 1);
+
+	if (rename(tmp, METRICS_PATH) < 0) {
+		warn("failed to create %s", METRICS_PATH);
+		munmap(page, sizeof(*page));
+		page = NULL;
+		goto err_unlink;
+	}
+
+	close(fd);
+
+	clock_gettime(CLOCK_MONOTONIC, &last_publish);
+	atomic_store_explicit(&dirty, true, memory_order_relaxed);
+
+	return 0;
+
+err_unlink:
+	unlink(tmp);
+	close(fd);
+
+	return -1;
+}
+
+/**
+ * metrics_add() - increment a counter
+ * @counter:	counter to increment
+ * @n:		amount to add
+ */
+void metrics_add(enum metrics_counter counter, uint64_t n)
+{
+	atomic_fetch_add_explicit(&counters[counter], n, memory_order_relaxed);
+	atomic_store_explicit(&dirty, true, memory_order_relaxed);
+}
+
+/**
+ * metrics_time() - record the time elapsed since @start in a histogram
+ * @histogram:	histogram to update
+ * @start:	CLOCK_MONOTONIC time at which the measured operation started
+ *
+ * Return: time elapsed, in us
+ */
+uint64_t metrics_time(enum metrics_histogram histogram,
+		      const struct timespec *start)
+{
+	struct timespec now;
+	unsigned int bucket = 0;
+	uint64_t elapsed;
+	uint64_t us;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	elapsed = (now.tv_sec - start->tv_sec) * 1000000 +
+		  (now.tv_nsec - start->tv_nsec) / 1000;
+
+	/* Bucket n counts values in [2^(n-1), 2^n) */
+	for (us = elapsed; us && bucket < METRICS_BUCKETS - 1; us >>= 1)
+		bucket++;
+
+	atomic_fetch_add_explicit(&histograms[histogram][bucket], 1,
+				  memory_order_relaxed);
+	atomic_store_explicit(&dirty, true, memory_order_relaxed);
+
+	return elapsed;
+}
+
+static void metrics_publish(void)
+{
+	uint32_t seq;
+	uint64_t v;
+	int i;
+	int j;
+
+	seq = atomic_load_explicit(&page->seq, memory_order_relaxed);
+	atomic_store_explicit(&page->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	for (i = 0; i < METRICS_NR_COUNTERS; i++) {
+		v = atomic_load_explicit(&counters[i], memory_order_relaxed);
+		atomic_store_explicit(&page->counters[i], v, memory_order_relaxed);
+	}
+
+	for (i = 0; i < METRICS_NR_HISTOGRAMS; i++) {
+		for (j = 0; j < METRICS_BUCKETS; j++) {
+			v = atomic_load_explicit(&histograms[i][j], memory_order_relaxed);
+			atomic_store_explicit(&page->histograms[i][j], v,
+					      memory_order_relaxed);
+		}
+	}
+
+	atomic_store_explicit(&page->updated, now_ns(), memory_order_relaxed);
+	atomic_store_explicit(&page->seq, seq + 2, memory_order_release);
+}
+
+/**
+ * metrics_timeout() - time until metrics_tick() needs to be called
+ *
+ * Return: timeout in ms, -1 if none is needed
+ */
+int metrics_timeout(void)
+{
+	long remaining;
+
+	if (!page || !atomic_load_explicit(&dirty, memory_order_relaxed))
+		return -1;
+
+	remaining = PUBLISH_INTERVAL - elapsed_ms(&last_publish);
+
+	return remaining > 0 ? remaining : 0;
+}
+
+/**
+ * metrics_tick() - update the metrics file, if anything changed for a while
+ */
+void metrics_tick(void)
+{
+	if (!page || !atomic_load_explicit(&dirty, memory_order_relaxed) ||
+	    elapsed_ms(&last_publish) < PUBLISH_INTERVAL)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &last_publish);
+	atomic_store_explicit(&dirty, false, memory_order_relaxed);
+	metrics_publish();
+}
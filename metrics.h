@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifndef ANDROID
+#define METRICS_PATH		"/run/tqftpserv-metrics"
+#else
+#define METRICS_PATH		"/data/vendor/tmp/tqftpserv-metrics"
+#endif
+
+#define METRICS_MAGIC		0x7471736d	/* "tqsm" */
+#define METRICS_VERSION		1
+
+#define METRICS_NAME_MAX	32
+
+/* Histograms count values in log2 buckets, of microseconds */
+#define METRICS_BUCKETS		24
+
+enum metrics_counter {
+	METRICS_RRQ,
+	METRICS_WRQ,
+	METRICS_BYTES_SENT,
+	METRICS_BYTES_RECEIVED,
+	METRICS_BLOCKS_SENT,
+	METRICS_BLOCKS_RECEIVED,
+	METRICS_RETRANSMITS,
+	METRICS_CACHE_HITS,
+	METRICS_CACHE_MISSES,
+	/* Syscalls made on the data path, to be divided by blocks */
+	METRICS_SYSCALLS,
+	/* Errors sent, by TFTP error code */
+	METRICS_ERRORS,
+	METRICS_NR_COUNTERS = METRICS_ERRORS + 9,
+};
+
+enum metrics_histogram {
+	METRICS_OPEN,
+	METRICS_RESOLVE,
+	METRICS_DECOMPRESS,
+	METRICS_NR_HISTOGRAMS,
+};
+
+/*
+ * Layout of the metrics file, a snapshot of the counters published under a
+ * seqlock: @seq is odd while being updated, readers retry until they read
+ * the same even value before and after copying.
+ */
+struct metrics_page {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t ncounters;
+	uint32_t nhistograms;
+	uint32_t nbuckets;
+	_Atomic uint32_t seq;
+
+	/* CLOCK_MONOTONIC, in ns, of the start and of the last update */
+	_Atomic uint64_t started;
+	_Atomic uint64_t updated;
+
+	char counter_names[METRICS_NR_COUNTERS][METRICS_NAME_MAX];
+	char histogram_names[METRICS_NR_HISTOGRAMS][METRICS_NAME_MAX];
+
+	_Atomic uint64_t counters[METRICS_NR_COUNTERS];
+	_Atomic uint64_t histograms[METRICS_NR_HISTOGRAMS][METRICS_BUCKETS];
+};
+
+int metrics_init(void);
+void metrics_add(enum metrics_counter counter, uint64_t n);
+uint64_t metrics_time(enum metrics_histogram histogram,
+		      const struct timespec *start);
+int metrics_timeout(void);
+void metrics_tick(void);
+
+#endif
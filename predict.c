@@ -0,0 +1,236 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "list.h"
+#include "predict.h"
+#include "prefetch.h"
+
+/* Bounds on the size of the model, per remote */
+#define PREDICT_MAX_FILES	512
+#define PREDICT_MAX_SUCCESSORS	8
+
+/* Only prefetch successors seen at least this often after a file */
+#define PREDICT_MIN_COUNT	2
+#define PREDICT_MIN_PERCENT	25
+
+/* A file which was requested following another one */
+struct predict_successor {
+	struct list_head node;
+
+	char *path;
+	size_t size;
+	unsigned int count;
+};
+
+struct predict_file {
+	struct list_head node;
+
+	char *path;
+	unsigned int total;
+	unsigned int nsuccessors;
+
+	struct list_head successors;
+};
+
+struct predict_remote {
+	struct list_head node;
+
+	unsigned int node_id;
+	char *last;
+	unsigned int nfiles;
+
+	struct list_head files;
+};
+
+static struct list_head remotes = LIST_INIT(remotes);
+
+static size_t predict_budget;
+
+static struct predict_remote *predict_remote_get(unsigned int node_id)
+{
+	struct predict_remote *remote;
+
+	list_for_each_entry(remote, &remotes, node) {
+		if (remote->node_id == node_id)
+			return remote;
+	}
+
+	remote = calloc(1, sizeof(*remote));
+	if (!remote)
+		return NULL;
+
+	remote->node_id = node_id;
+	list_init(&remote->files);
+	list_add(&remotes, &remote->node);
+
+	return remote;
+}
+
+static struct predict_file *predict_file_find(struct predict_remote *remote,
+					      const char *path)
+{
+	struct predict_file *file;
+
+	list_for_each_entry(file, &remote->files, node) {
+		if (!strcmp(file->path, path))
+			return file;
+	}
+
+	return NULL;
+}
+
+/* Count one occurrence of @path being requested after @prev */
+static void predict_learn(struct predict_remote *remote, const char *prev,
+			  const char *path, size_t size)
+{
+	struct predict_successor *succ;
+	struct predict_file *file;
+
+	file = predict_file_find(remote, prev);
+	if (!file) {
+		if (remote->nfiles >= PREDICT_MAX_FILES)
+			return;
+
+		file = calloc(1, sizeof(*file));
+		if (!file)
+			return;
+
+		file->path = strdup(prev);
+		list_init(&file->successors);
+		list_add(&remote->files, &file->node);
+		remote->nfiles++;
+	}
+
+	file->total++;
+
+	list_for_each_entry(succ, &file->successors, node) {
+		if (!strcmp(succ->path, path)) {
+			succ->size = size;
+			succ->count++;
+			return;
+		}
+	}
+
+	if (file->nsuccessors >= PREDICT_MAX_SUCCESSORS)
+		return;
+
+	succ = calloc(1, sizeof(*succ));
+	if (!succ)
+		return;
+
+	succ->path = strdup(path);
+	succ->size = size;
+	succ->count = 1;
+	list_add(&file->successors, &succ->node);
+	file->nsuccessors++;
+}
+
+/* Prefetch the likely successors of @path, most likely first */
+static void predict_prefetch(struct predict_remote *remote, const char *path)
+{
+	struct predict_successor *candidates[PREDICT_MAX_SUCCESSORS];
+	struct predict_successor *succ;
+	struct predict_file *file;
+	size_t budget = predict_budget;
+	unsigned int n = 0;
+	unsigned int i;
+	unsigned int j;
+
+	file = predict_file_find(remote, path);
+	if (!file)
+		return;
+
+	list_for_each_entry(succ, &file->successors, node) {
+		if (succ->count < PREDICT_MIN_COUNT ||
+		    succ->count * 100 < file->total * PREDICT_MIN_PERCENT)
+			continue;
+
+		/* Insertion sort on count, there's a handful of them at most */
+		for (i = n; i > 0 && candidates[i - 1]->count < succ->count; i--)
+			candidates[i] = candidates[i - 1];
+		candidates[i] = succ;
+		n++;
+	}
+
+	for (j = 0; j < n; j++) {
+		if (candidates[j]->size > budget)
+			break;
+
+		budget -= candidates[j]->size;
+		prefetch_queue(candidates[j]->path, 0, 0);
+	}
+}
+
+/**
+ * predict_init() - enable prefetching of files likely to be requested next
+ * @budget:	maximum number of bytes to prefetch following each request, 0
+ *		to stop prefetching
+ *
+ * May be called again to change the budget.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int predict_init(size_t budget)
+{
+	if (budget && prefetch_init() < 0)
+		return -1;
+
+	predict_budget = budget;
+
+	return 0;
+}
+
+/**
+ * predict_record() - learn from, and act on, a read request
+ * @node_id:	qrtr node of the remote
+ * @path:	path, as requested by the remote
+ * @size:	size of the requested file
+ *
+ * A per-remote table of which files were requested following which is kept,
+ * and the files that have commonly followed @path are prefetched, up to the
+ * configured budget. Repeated requests for the same file, e.g. reading it in
+ * pieces, do not count as a transition.
+ */
+void predict_record(unsigned int node_id, const char *path, size_t size)
+{
+	struct predict_remote *remote;
+
+	if (!predict_budget)
+		return;
+
+	remote = predict_remote_get(node_id);
+	if (!remote)
+		return;
+
+	if (remote->last && !strcmp(remote->last, path))
+		return;
+
+	if (remote->last)
+		predict_learn(remote, remote->last, path, size);
+
+	free(remote->last);
+	remote->last = strdup(path);
+
+	predict_prefetch(remote, path);
+}
+
+/**
+ * predict_reset() - the remote went away, forget its last request
+ * @node_id:	qrtr node of the remote
+ */
+void predict_reset(unsigned int node_id)
+{
+	struct predict_remote *remote;
+
+	list_for_each_entry(remote, &remotes, node) {
+		if (remote->node_id == node_id) {
+			free(remote->last);
+			remote->last = NULL;
+			return;
+		}
+	}
+}
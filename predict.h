@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __PREDICT_H__
+#define __PREDICT_H__
+
+#include <stddef.h>
+
+#include "profile.h"
+
+#if TQFTP_WITH_CACHE
+int predict_init(size_t budget);
+void predict_record(unsigned int node_id, const char *path, size_t size);
+void predict_reset(unsigned int node_id);
+#else
+static inline int predict_init(size_t budget) { return -1; }
+static inline void predict_record(unsigned int node_id, const char *path,
+				  size_t size) {}
+static inline void predict_reset(unsigned int node_id) {}
+#endif
+
+#endif
@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+/* For readahead */
+#define _GNU_SOURCE
+
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "blockcache.h"
+#include "cache.h"
+#include "list.h"
+#include "logger.h"
+#include "membudget.h"
+#include "prefetch.h"
+#include "translate.h"
+
+struct prefetch_request {
+	struct list_head node;
+
+	char *path;
+	off_t offset;
+	size_t len;
+
+	/* Pin the file once cached, see prefetch_pin() */
+	bool pin;
+};
+
+static struct list_head requests = LIST_INIT(requests);
+static pthread_mutex_t prefetch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t prefetch_cond = PTHREAD_COND_INITIALIZER;
+static bool prefetch_running;
+static bool prefetch_paused;
+
+static void prefetch_free(struct prefetch_request *req)
+{
+	membudget_account(MEMBUDGET_PREFETCH,
+			  -(ssize_t)(sizeof(*req) + strlen(req->path) + 1));
+	free(req->path);
+	free(req);
+}
+
+/* Prefetching is the first thing to go when memory gets tight */
+static void prefetch_pressure(unsigned int level)
+{
+	struct prefetch_request *req;
+	struct prefetch_request *next;
+
+	pthread_mutex_lock(&prefetch_lock);
+	prefetch_paused = level > 0;
+	if (prefetch_paused) {
+		list_for_each_entry_safe(req, next, &requests, node) {
+			list_del(&req->node);
+			prefetch_free(req);
+		}
+	}
+	pthread_mutex_unlock(&prefetch_lock);
+}
+
+static void prefetch_one(struct prefetch_request *req)
+{
+	struct blockcache_file *blocks;
+	struct stat sb;
+	size_t len;
+	int fd;
+
+	if (cache_open(req->path, &fd, &blocks) < 0) {
+		fd = translate_open(req->path, O_RDONLY);
+		if (fd < 0) {
+			if (req->pin)
+				pr_warn("unable to open %s, not pinning", req->path);
+			return;
+		}
+
+		cache_insert(req->path, fd);
+	}
+
+	if (req->pin && cache_pin(req->path, true) < 0)
+		pr_warn("unable to cache %s, not pinning", req->path);
+
+	if (blocks) {
+		/* Already in memory */
+		blockcache_put(blocks);
+		return;
+	}
+
+	len = req->len;
+	if (!len && !fstat(fd, &sb))
+		len = sb.st_size;
+
+	readahead(fd, req->offset, len);
+	close(fd);
+}
+
+static void *prefetch_thread(void *data)
+{
+	struct prefetch_request *req;
+
+	for (;;) {
+		pthread_mutex_lock(&prefetch_lock);
+		while (list_empty(&requests))
+			pthread_cond_wait(&prefetch_cond, &prefetch_lock);
+
+		req = list_entry_first(&requests, struct prefetch_request, node);
+		list_del(&req->node);
+		pthread_mutex_unlock(&prefetch_lock);
+
+		prefetch_one(req);
+		prefetch_free(req);
+	}
+
+	return NULL;
+}
+
+/**
+ * prefetch_init() - start the prefetch worker
+ *
+ * Return: 0 on success, -1 on error
+ */
+int prefetch_init(void)
+{
+	pthread_t thread;
+	int ret;
+
+	if (prefetch_running)
+		return 0;
+
+	ret = pthread_create(&thread, NULL, prefetch_thread, NULL);
+	if (ret) {
+		errno = ret;
+		return -1;
+	}
+	pthread_detach(thread);
+
+	membudget_register(prefetch_pressure);
+	prefetch_running = true;
+
+	return 0;
+}
+
+static int prefetch_add(const char *path, off_t offset, size_t len, bool pin)
+{
+	struct prefetch_request *req;
+
+	if (!prefetch_running || !translate_cacheable(path))
+		return -1;
+
+	req = calloc(1, sizeof(*req));
+	if (!req)
+		return -1;
+
+	req->path = strdup(path);
+	req->offset = offset;
+	req->len = len;
+	req->pin = pin;
+	membudget_account(MEMBUDGET_PREFETCH, sizeof(*req) + strlen(path) + 1);
+
+	pthread_mutex_lock(&prefetch_lock);
+	if (prefetch_paused) {
+		pthread_mutex_unlock(&prefetch_lock);
+		prefetch_free(req);
+		return -1;
+	}
+	list_add(&requests, &req->node);
+	pthread_cond_signal(&prefetch_cond);
+	pthread_mutex_unlock(&prefetch_lock);
+
+	return 0;
+}
+
+/**
+ * prefetch_queue() - resolve and warm up a file ahead of its request
+ * @path:	path, as would be requested by the remote
+ * @offset:	offset of the range expected to be read
+ * @len:	length of the range expected to be read, 0 for the entire file
+ *
+ * The file is resolved, decompressed if needed, added to the cache and the
+ * requested range is read into the page cache, in the background and in the
+ * order requests are queued.
+ */
+void prefetch_queue(const char *path, off_t offset, size_t len)
+{
+	prefetch_add(path, offset, len, false);
+}
+
+/**
+ * prefetch_pin() - cache a file in the background and pin it, see cache_pin()
+ * @path:	path, as would be requested by the remote
+ *
+ * Return: 0 if queued, -1 if the file can't be cached or memory is tight
+ */
+int prefetch_pin(const char *path)
+{
+	return prefetch_add(path, 0, 0, true);
+}
@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __PREFETCH_H__
+#define __PREFETCH_H__
+
+#include <sys/types.h>
+
+#include "profile.h"
+
+#if TQFTP_WITH_CACHE
+int prefetch_init(void);
+void prefetch_queue(const char *path, off_t offset, size_t len);
+int prefetch_pin(const char *path);
+#else
+static inline int prefetch_init(void) { return -1; }
+static inline int prefetch_pin(const char *path) { return -1; }
+#endif
+
+#endif
@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include "probes.h"
+
+/* Probe semaphores, in the section the tracers look them up in */
+#define PROBE_SEMAPHORE(name) \
+	unsigned short tqftpserv_##name##_semaphore \
+		__attribute__((section(".probes")))
+
+PROBE_SEMAPHORE(rrq);
+PROBE_SEMAPHORE(wrq);
+PROBE_SEMAPHORE(translate__open__start);
+PROBE_SEMAPHORE(translate__open__end);
+PROBE_SEMAPHORE(decompress__start);
+PROBE_SEMAPHORE(decompress__end);
+PROBE_SEMAPHORE(data__send);
+PROBE_SEMAPHORE(ack);
+PROBE_SEMAPHORE(retransmit);
+PROBE_SEMAPHORE(client__close);
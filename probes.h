@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __PROBES_H__
+#define __PROBES_H__
+
+/*
+ * USDT probes of the "tqftpserv" provider, for perf and bpftrace, e.g.
+ *
+ *   bpftrace -e 'usdt:/usr/bin/tqftpserv:tqftpserv:ack { @rtt = hist(arg3); }'
+ *
+ * A probe is a nop until attached to. Arguments that cost anything to
+ * compute are only computed while TQFTP_PROBE_ENABLED() is true, i.e. while
+ * the probe is attached to. Without sys/sdt.h the probes are compiled out.
+ *
+ *   rrq, wrq			node, port, filename
+ *   translate__open__start	path
+ *   translate__open__end	path, fd, latency (us)
+ *   decompress__start		filename
+ *   decompress__end		filename, size, latency (us)
+ *   data__send			node, port, block, size
+ *   ack			node, port, block, latency since the window was sent (us)
+ *   retransmit			node, port, block following the last one acknowledged
+ *   client__close		node, port, size, latency since the request (us)
+ */
+
+#ifdef HAVE_SYS_SDT_H
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define TQFTP_PROBE_ENABLED(name) \
+	__builtin_expect(tqftpserv_##name##_semaphore, 0)
+
+#define TQFTP_PROBE1(name, a) \
+	DTRACE_PROBE1(tqftpserv, name, a)
+#define TQFTP_PROBE3(name, a, b, c) \
+	DTRACE_PROBE3(tqftpserv, name, a, b, c)
+#define TQFTP_PROBE4(name, a, b, c, d) \
+	DTRACE_PROBE4(tqftpserv, name, a, b, c, d)
+
+/* Set by the kernel while a probe is attached to, defined in probes.c */
+extern unsigned short tqftpserv_rrq_semaphore;
+extern unsigned short tqftpserv_wrq_semaphore;
+extern unsigned short tqftpserv_translate__open__start_semaphore;
+extern unsigned short tqftpserv_translate__open__end_semaphore;
+extern unsigned short tqftpserv_decompress__start_semaphore;
+extern unsigned short tqftpserv_decompress__end_semaphore;
+extern unsigned short tqftpserv_data__send_semaphore;
+extern unsigned short tqftpserv_ack_semaphore;
+extern unsigned short tqftpserv_retransmit_semaphore;
+extern unsigned short tqftpserv_client__close_semaphore;
+
+#else
+
+#define TQFTP_PROBE_ENABLED(name) 0
+
+#define TQFTP_PROBE1(name, a) \
+	do { (void)(a); } while (0)
+#define TQFTP_PROBE3(name, a, b, c) \
+	do { (void)(a); (void)(b); (void)(c); } while (0)
+#define TQFTP_PROBE4(name, a, b, c, d) \
+	do { (void)(a); (void)(b); (void)(c); (void)(d); } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+/*
+ * Compile-time capacities and features, set by the build profile. The
+ * defaults below match the "full" profile.
+ */
+
+/* Number of concurrent transfers, kept in static arrays; 0 for no fixed limit */
+#ifndef TQFTP_MAX_CLIENTS
+#define TQFTP_MAX_CLIENTS	0
+#endif
+
+/* Largest blksize negotiated, 65464 being the most allowed by RFC 2348 */
+#ifndef TQFTP_MAX_BLKSIZE
+#define TQFTP_MAX_BLKSIZE	65464
+#endif
+
+/* Largest wsize negotiated; 0 for no limit */
+#ifndef TQFTP_MAX_WSIZE
+#define TQFTP_MAX_WSIZE		0
+#endif
+
+/* Transparent decompression of .zst files, and compression at rest */
+#ifndef TQFTP_WITH_ZSTD
+#define TQFTP_WITH_ZSTD		1
+#endif
+
+/* Caching of resolved files, and everything prefetching into the cache */
+#ifndef TQFTP_WITH_CACHE
+#define TQFTP_WITH_CACHE	1
+#endif
+
+/* Most verbose syslog level compiled in, LOG_DEBUG */
+#ifndef TQFTP_LOG_LEVEL
+#define TQFTP_LOG_LEVEL		7
+#endif
+
+#if TQFTP_WITH_CACHE && !TQFTP_WITH_ZSTD
+#error "the cache requires zstd, for compressed in-memory copies"
+#endif
+
+#endif
@@ -0,0 +1,297 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "profiler.h"
+
+/* Files and nodes broken down, others are accounted together */
+#define PROFILER_FILES		64
+#define PROFILER_NODES		16
+#define PROFILER_NAME_MAX	64
+
+/* Costs are in CPU cycles, or in ns of CPU time without a cycle counter */
+struct profiler_stats {
+	uint64_t cost[PROFILER_NR_PHASES];
+	uint64_t calls[PROFILER_NR_PHASES];
+
+	/* Read from files and sent, or received and written to files */
+	uint64_t bytes;
+};
+
+struct profiler_file {
+	char name[PROFILER_NAME_MAX];
+	struct profiler_stats stats;
+};
+
+struct profiler_node {
+	int node;
+	struct profiler_stats stats;
+};
+
+static const char * const phase_names[PROFILER_NR_PHASES] = {
+	[PROFILER_RESOLVE] = "resolve",
+	[PROFILER_DECOMPRESS] = "decompress",
+	[PROFILER_READ] = "read",
+	[PROFILER_SEND] = "send",
+	[PROFILER_RECEIVE] = "receive",
+};
+
+bool profiler_enabled;
+
+/* Whether costs are counted in cycles, as decided by profiler_enable() */
+static bool profiler_cycles;
+
+static pthread_mutex_t profiler_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct profiler_file files[PROFILER_FILES];
+static struct profiler_node nodes[PROFILER_NODES];
+static unsigned int nfiles;
+static unsigned int nnodes;
+static struct profiler_stats other_files;
+static struct profiler_stats other_nodes;
+static struct profiler_stats total;
+
+/* Phases of this thread are attributed to, unless given */
+static __thread const char *attached_file;
+static __thread int attached_node = -1;
+
+/* Cost of the phases ended by this thread, less that of nested ones */
+static __thread uint64_t thread_accounted;
+
+/* Cycle counter of this thread, -1 until opened, -2 if it can't be */
+static __thread int thread_cycles_fd = -1;
+
+static int cycles_open(void)
+{
+	struct perf_event_attr attr = {
+		.type = PERF_TYPE_HARDWARE,
+		.size = sizeof(attr),
+		.config = PERF_COUNT_HW_CPU_CYCLES,
+		.exclude_hv = 1,
+	};
+
+	/* This thread, on any CPU, kernel included for the syscalls */
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+		       PERF_FLAG_FD_CLOEXEC);
+}
+
+/* Return: cycles, or ns of CPU time, spent by this thread so far */
+static uint64_t thread_cost(void)
+{
+	struct timespec ts;
+	uint64_t cycles;
+
+	if (profiler_cycles) {
+		if (thread_cycles_fd == -1) {
+			thread_cycles_fd = cycles_open();
+			if (thread_cycles_fd < 0)
+				thread_cycles_fd = -2;
+		}
+
+		if (thread_cycles_fd < 0 ||
+		    read(thread_cycles_fd, &cycles, sizeof(cycles)) != sizeof(cycles))
+			return 0;
+
+		return cycles;
+	}
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * profiler_enable() - measure the CPU cost of each phase of transfers
+ *
+ * Costs are counted in CPU cycles, by a perf_event_open() counter per thread,
+ * or in CPU time if the counter isn't available, e.g. with a restrictive
+ * perf_event_paranoid or in a VM. Each phase measured costs two reads of the
+ * counter or clock, so this is off unless asked for.
+ */
+void profiler_enable(void)
+{
+	thread_cycles_fd = cycles_open();
+	if (thread_cycles_fd < 0)
+		thread_cycles_fd = -2;
+
+	profiler_cycles = thread_cycles_fd >= 0;
+	profiler_enabled = true;
+}
+
+/**
+ * profiler_attach() - attribute phases of this thread given no file or node
+ * @file:	file requested, NULL to stop
+ * @node:	node of the remote requesting it
+ *
+ * For phases measured deep in code that doesn't know about the transfer,
+ * e.g. decompression in translate_open().
+ */
+void profiler_attach(const char *file, int node)
+{
+	attached_file = file;
+	attached_node = file ? node : -1;
+}
+
+/**
+ * profiler_begin() - start measuring a phase
+ * @span:	measurement, for profiler_end()
+ */
+void profiler_begin(struct profiler_span *span)
+{
+	if (!profiler_enabled)
+		return;
+
+	span->start = thread_cost();
+	span->nested = thread_accounted;
+}
+
+static struct profiler_stats *profiler_file_stats(const char *file)
+{
+	size_t len = strlen(file);
+	unsigned int i;
+
+	/* Keep the end of long paths, which tells files apart */
+	if (len >= PROFILER_NAME_MAX)
+		file += len - (PROFILER_NAME_MAX - 1);
+
+	for (i = 0; i < nfiles; i++) {
+		if (!strcmp(files[i].name, file))
+			return &files[i].stats;
+	}
+
+	if (nfiles == PROFILER_FILES)
+		return &other_files;
+
+	strcpy(files[nfiles].name, file);
+	return &files[nfiles++].stats;
+}
+
+static struct profiler_stats *profiler_node_stats(int node)
+{
+	unsigned int i;
+
+	for (i = 0; i < nnodes; i++) {
+		if (nodes[i].node == node)
+			return &nodes[i].stats;
+	}
+
+	if (nnodes == PROFILER_NODES)
+		return &other_nodes;
+
+	nodes[nnodes].node = node;
+	return &nodes[nnodes++].stats;
+}
+
+static void profiler_account(struct profiler_stats *stats,
+			     enum profiler_phase phase, uint64_t cost, size_t bytes)
+{
+	stats->cost[phase] += cost;
+	stats->calls[phase]++;
+	if (phase == PROFILER_READ || phase == PROFILER_RECEIVE)
+		stats->bytes += bytes;
+}
+
+/**
+ * profiler_end() - account the CPU cost of a phase
+ * @span:	measurement started by profiler_begin()
+ * @phase:	phase measured
+ * @file:	file the phase is for, NULL for the one attached to this thread
+ * @node:	node the phase is for, ignored if @file is NULL
+ * @bytes:	bytes read or received, for the cost per byte
+ *
+ * Phases measured within @span are only accounted to their own phase.
+ */
+void profiler_end(struct profiler_span *span, enum profiler_phase phase,
+		  const char *file, int node, size_t bytes)
+{
+	uint64_t cost;
+
+	if (!profiler_enabled)
+		return;
+
+	cost = thread_cost() - span->start - (thread_accounted - span->nested);
+	thread_accounted += cost;
+
+	if (!file) {
+		file = attached_file ? attached_file : "(background)";
+		node = attached_node;
+	}
+
+	pthread_mutex_lock(&profiler_lock);
+	profiler_account(&total, phase, cost, bytes);
+	profiler_account(profiler_file_stats(file), phase, cost, bytes);
+	profiler_account(node >= 0 ? profiler_node_stats(node) : &other_nodes,
+			 phase, cost, bytes);
+	pthread_mutex_unlock(&profiler_lock);
+}
+
+static void profiler_dump_header(FILE *f, const char *what)
+{
+	int i;
+
+	fprintf(f, "[TQFTP] %-32s", what);
+	for (i = 0; i < PROFILER_NR_PHASES; i++)
+		fprintf(f, " %10s", phase_names[i]);
+	fprintf(f, " %12s %11s\n", "bytes",
+		profiler_cycles ? "cycles/byte" : "ns/byte");
+}
+
+static void profiler_dump_stats(FILE *f, const char *name,
+				const struct profiler_stats *stats)
+{
+	uint64_t cost = 0;
+	int i;
+
+	fprintf(f, "[TQFTP] %-32s", name);
+	for (i = 0; i < PROFILER_NR_PHASES; i++) {
+		fprintf(f, " %10llu", (unsigned long long)(stats->cost[i] / 1000));
+		cost += stats->cost[i];
+	}
+	fprintf(f, " %12llu", (unsigned long long)stats->bytes);
+	if (stats->bytes)
+		fprintf(f, " %11.1f\n", (double)cost / stats->bytes);
+	else
+		fprintf(f, " %11s\n", "-");
+}
+
+/**
+ * profiler_dump() - print the CPU cost of each phase, per file and per node
+ * @f:		stream to print to
+ */
+void profiler_dump(FILE *f)
+{
+	char name[16];
+	unsigned int i;
+
+	if (!profiler_enabled) {
+		fprintf(f, "[TQFTP] profiler not enabled\n");
+		return;
+	}
+
+	pthread_mutex_lock(&profiler_lock);
+
+	profiler_dump_header(f, profiler_cycles ? "kcycles, per file" :
+					    "CPU time in us, per file");
+	for (i = 0; i < nfiles; i++)
+		profiler_dump_stats(f, files[i].name, &files[i].stats);
+	if (nfiles == PROFILER_FILES)
+		profiler_dump_stats(f, "(other files)", &other_files);
+
+	profiler_dump_header(f, profiler_cycles ? "kcycles, per node" :
+					    "CPU time in us, per node");
+	for (i = 0; i < nnodes; i++) {
+		snprintf(name, sizeof(name), "%d", nodes[i].node);
+		profiler_dump_stats(f, name, &nodes[i].stats);
+	}
+	profiler_dump_stats(f, "(other nodes)", &other_nodes);
+
+	profiler_dump_stats(f, "total", &total);
+
+	pthread_mutex_unlock(&profiler_lock);
+}
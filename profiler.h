@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+enum profiler_phase {
+	PROFILER_RESOLVE,
+	PROFILER_DECOMPRESS,
+	PROFILER_READ,
+	PROFILER_SEND,
+	PROFILER_RECEIVE,
+	PROFILER_NR_PHASES,
+};
+
+/* CPU cost of the thread at the start of a phase, and of the phases within */
+struct profiler_span {
+	uint64_t start;
+	uint64_t nested;
+};
+
+extern bool profiler_enabled;
+
+void profiler_enable(void);
+void profiler_attach(const char *file, int node);
+void profiler_begin(struct profiler_span *span);
+void profiler_end(struct profiler_span *span, enum profiler_phase phase,
+		  const char *file, int node, size_t bytes);
+void profiler_dump(FILE *f);
+
+#endif
@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <dirent.h>
+#include <err.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "prefetch.h"
+#include "remoteproc.h"
+#include "translate.h"
+
+#define REMOTEPROC_CLASS	"/sys/class/remoteproc"
+
+static int read_attr(const char *name, const char *attr, char *buf, size_t len)
+{
+	char path[PATH_MAX];
+	ssize_t n;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s/%s", REMOTEPROC_CLASS, name, attr);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	n = read(fd, buf, len - 1);
+	close(fd);
+	if (n <= 0)
+		return -1;
+
+	buf[n] = '\0';
+	buf[strcspn(buf, "\n")] = '\0';
+
+	return 0;
+}
+
+/* Prefetch each indexed file, for as long as it would fit in the cache */
+static void prefetch_indexed(const char *path, size_t size, void *data)
+{
+	size_t *remaining = data;
+
+	if (size > *remaining)
+		return;
+
+	*remaining -= size;
+	prefetch_queue(path, 0, 0);
+}
+
+/**
+ * remoteproc_prefetch() - prefetch the firmware directory of a remoteproc
+ * @name:	name of the remoteproc, as listed in /sys/class/remoteproc
+ */
+void remoteproc_prefetch(const char *name)
+{
+	char firmware[PATH_MAX];
+	size_t remaining = cache_capacity();
+
+	if (read_attr(name, "firmware", firmware, sizeof(firmware)) < 0)
+		return;
+
+	translate_index_firmware(firmware, prefetch_indexed, &remaining);
+}
+
+/**
+ * remoteproc_index_all() - index the firmware directories of all remoteprocs
+ */
+void remoteproc_index_all(void)
+{
+	char firmware[PATH_MAX];
+	struct dirent *de;
+	DIR *dir;
+
+	dir = opendir(REMOTEPROC_CLASS);
+	if (!dir)
+		return;
+
+	while ((de = readdir(dir)) != NULL) {
+		if (de->d_name[0] == '.')
+			continue;
+
+		if (read_attr(de->d_name, "firmware", firmware, sizeof(firmware)) < 0)
+			continue;
+
+		translate_index_firmware(firmware, NULL, NULL);
+	}
+
+	closedir(dir);
+}
+
+/**
+ * remoteproc_uevent_open() - listen for remoteproc state changes
+ *
+ * Return: netlink socket to pass to remoteproc_uevent_handle(), -1 on error
+ */
+int remoteproc_uevent_open(void)
+{
+	struct sockaddr_nl addr = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = 1,
+	};
+	int fd;
+
+	fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+		    NETLINK_KOBJECT_UEVENT);
+	if (fd < 0) {
+		warn("failed to open uevent socket");
+		return -1;
+	}
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		warn("failed to bind uevent socket");
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/**
+ * remoteproc_uevent_handle() - act on a pending uevent
+ * @fd:		socket returned by remoteproc_uevent_open()
+ *
+ * Remoteprocs which are added, or change state to running, have their
+ * firmware directory indexed and prefetched; so that the files are warm by
+ * the time the freshly booted remote requests them.
+ */
+void remoteproc_uevent_handle(int fd)
+{
+	const char *subsystem = NULL;
+	const char *devpath = NULL;
+	const char *action = NULL;
+	char state[32];
+	char buf[4096];
+	const char *name;
+	ssize_t len;
+	char *p;
+
+	len = recv(fd, buf, sizeof(buf) - 1, 0);
+	if (len <= 0)
+		return;
+	buf[len] = '\0';
+
+	/* "action@devpath" header, followed by NUL-separated KEY=value pairs */
+	for (p = buf; p < buf + len; p += strlen(p) + 1) {
+		if (!strncmp(p, "ACTION=", 7))
+			action = p + 7;
+		else if (!strncmp(p, "DEVPATH=", 8))
+			devpath = p + 8;
+		else if (!strncmp(p, "SUBSYSTEM=", 10))
+			subsystem = p + 10;
+	}
+
+	if (!action || !devpath || !subsystem || strcmp(subsystem, "remoteproc"))
+		return;
+
+	name = strrchr(devpath, '/');
+	if (!name)
+		return;
+	name++;
+
+	if (strcmp(action, "add")) {
+		if (strcmp(action, "change") ||
+		    read_attr(name, "state", state, sizeof(state)) < 0 ||
+		    (strcmp(state, "running") && strcmp(state, "attached")))
+			return;
+	}
+
+	remoteproc_prefetch(name);
+}
@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __REMOTEPROC_H__
+#define __REMOTEPROC_H__
+
+#include "profile.h"
+
+#if TQFTP_WITH_CACHE
+void remoteproc_prefetch(const char *name);
+void remoteproc_index_all(void);
+int remoteproc_uevent_open(void);
+void remoteproc_uevent_handle(int fd);
+#else
+static inline void remoteproc_index_all(void) {}
+static inline int remoteproc_uevent_open(void) { return -1; }
+static inline void remoteproc_uevent_handle(int fd) {}
+#endif
+
+#endif
@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+/* For sched_setaffinity */
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <err.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "rt.h"
+
+static bool rt_enabled;
+static struct timespec packet_start;
+
+static uint64_t worst_ns;
+static uint64_t histogram[RT_HISTOGRAM_BUCKETS];
+
+/* Parse a list of CPUs, such as "0,2-3" */
+static int parse_cpus(const char *cpus, cpu_set_t *set)
+{
+	unsigned long first;
+	unsigned long last;
+	const char *p = cpus;
+	char *end;
+
+	CPU_ZERO(set);
+
+	while (*p) {
+		first = strtoul(p, &end, 10);
+		if (end == p)
+			return -1;
+
+		last = first;
+		if (*end == '-') {
+			p = end + 1;
+			last = strtoul(p, &end, 10);
+			if (end == p || last < first)
+				return -1;
+		}
+
+		for (; first <= last && first < CPU_SETSIZE; first++)
+			CPU_SET(first, set);
+
+		if (*end == ',')
+			end++;
+		else if (*end)
+			return -1;
+		p = end;
+	}
+
+	return CPU_COUNT(set) ? 0 : -1;
+}
+
+/**
+ * rt_init() - serve with bounded latency
+ * @priority:	SCHED_FIFO priority to run at, 0 to keep the current policy
+ * @cpus:	list of CPUs to run on, such as "0,2-3", or NULL
+ *
+ * All current and future memory is locked, so that serving a packet never
+ * waits on a page fault, and the worst-case time spent handling a packet is
+ * tracked. Callers are expected to preallocate what they need on the packet
+ * path.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int rt_init(int priority, const char *cpus)
+{
+	struct sched_param param = { .sched_priority = priority };
+	cpu_set_t set;
+
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+		warn("failed to lock memory");
+		return -1;
+	}
+
+	if (priority && sched_setscheduler(0, SCHED_FIFO, &param) < 0) {
+		warn("failed to set SCHED_FIFO priority %d", priority);
+		return -1;
+	}
+
+	if (cpus) {
+		if (parse_cpus(cpus, &set) < 0) {
+			warnx("invalid CPU list \"%s\"", cpus);
+			return -1;
+		}
+
+		if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+			warn("failed to set CPU affinity");
+			return -1;
+		}
+	}
+
+	rt_enabled = true;
+
+	return 0;
+}
+
+bool rt_active(void)
+{
+	return rt_enabled;
+}
+
+/**
+ * rt_packet_start() - start timing the handling of a packet
+ */
+void rt_packet_start(void)
+{
+	if (rt_enabled)
+		clock_gettime(CLOCK_MONOTONIC, &packet_start);
+}
+
+/**
+ * rt_packet_end() - done handling a packet
+ *
+ * The time taken is accounted in a histogram of log2 microsecond buckets,
+ * along with the worst case, reported by rt_dump() rather than from here.
+ */
+void rt_packet_end(void)
+{
+	struct timespec now;
+	unsigned int bucket = 0;
+	uint64_t us;
+	uint64_t ns;
+
+	if (!rt_enabled)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ns = (now.tv_sec - packet_start.tv_sec) * 1000000000ULL +
+	     now.tv_nsec - packet_start.tv_nsec;
+
+	for (us = ns / 1000; us && bucket < RT_HISTOGRAM_BUCKETS - 1; us >>= 1)
+		bucket++;
+	histogram[bucket]++;
+
+	if (ns > worst_ns)
+		worst_ns = ns;
+}
+
+/**
+ * rt_dump() - print the packet latency histogram
+ * @f:		stream to print to
+ */
+void rt_dump(FILE *f)
+{
+	unsigned int i;
+
+	fprintf(f, "[TQFTP] worst-case packet latency %llu us\n",
+		(unsigned long long)(worst_ns / 1000));
+
+	for (i = 0; i < RT_HISTOGRAM_BUCKETS; i++) {
+		if (histogram[i])
+			fprintf(f, "[TQFTP]   < %8llu us %llu\n", 1ULL << i,
+				(unsigned long long)histogram[i]);
+	}
+}
@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __RT_H__
+#define __RT_H__
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/* Bucket i counts packets handled in less than 2^i microseconds */
+#define RT_HISTOGRAM_BUCKETS	24
+
+int rt_init(int priority, const char *cpus);
+bool rt_active(void);
+void rt_packet_start(void);
+void rt_packet_end(void);
+void rt_dump(FILE *f);
+
+#endif
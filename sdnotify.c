@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sdnotify.h"
+
+/* File descriptors passed by the service manager start here */
+#define LISTEN_FDS_START	3
+
+#define MAX_NOTIFY_FDS		16
+
+/**
+ * sdnotify_available() - check if running under a service manager
+ */
+bool sdnotify_available(void)
+{
+	return getenv("NOTIFY_SOCKET") != NULL;
+}
+
+/**
+ * sdnotify_fds() - send a state update, along with fds, to the service manager
+ * @state:	newline separated list of assignments, e.g. "READY=1"
+ * @fds:	fds to pass, may be NULL
+ * @nfds:	number of fds in @fds
+ *
+ * Implements the sd_notify(3) protocol, so as to not depend on libsystemd.
+ *
+ * Return: 0 on success, -1 on error or if not running under a service manager
+ */
+int sdnotify_fds(const char *state, const int *fds, unsigned int nfds)
+{
+	char control[CMSG_SPACE(sizeof(int) * MAX_NOTIFY_FDS)] = {};
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct msghdr msg = {};
+	struct cmsghdr *cmsg;
+	const char *path;
+	struct iovec iov;
+	socklen_t addrlen;
+	size_t len;
+	ssize_t ret;
+	int sock;
+
+	path = getenv("NOTIFY_SOCKET");
+	if (!path || nfds > MAX_NOTIFY_FDS)
+		return -1;
+
+	len = strlen(path);
+	if (len < 2 || len >= sizeof(addr.sun_path) ||
+	    (path[0] != '/' && path[0] != '@'))
+		return -1;
+
+	memcpy(addr.sun_path, path, len);
+	/* Abstract namespace */
+	if (path[0] == '@')
+		addr.sun_path[0] = '\0';
+	addrlen = offsetof(struct sockaddr_un, sun_path) + len;
+
+	sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (sock < 0)
+		return -1;
+
+	iov.iov_base = (char *)state;
+	iov.iov_len = strlen(state);
+	msg.msg_name = &addr;
+	msg.msg_namelen = addrlen;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if (nfds) {
+		msg.msg_control = control;
+		msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+		memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nfds);
+	}
+
+	ret = sendmsg(sock, &msg, MSG_NOSIGNAL);
+	close(sock);
+
+	return ret < 0 ? -1 : 0;
+}
+
+/**
+ * sdnotify() - send a state update to the service manager
+ * @state:	newline separated list of assignments, e.g. "READY=1"
+ *
+ * Return: 0 on success, -1 on error or if not running under a service manager
+ */
+int sdnotify(const char *state)
+{
+	return sdnotify_fds(state, NULL, 0);
+}
+
+/**
+ * sdnotify_listen_fds() - take over fds passed by the service manager
+ * @cb:		called for each fd, with the name it was stored under
+ * @data:	opaque pointer passed to @cb
+ *
+ * Implements the sd_listen_fds_with_names(3) protocol. The environment
+ * variables are cleared, so that the fds aren't taken over twice or passed
+ * on to children.
+ *
+ * Return: number of fds passed to @cb
+ */
+int sdnotify_listen_fds(sdnotify_listen_cb_t cb, void *data)
+{
+	const char *listen_pid;
+	const char *listen_fds;
+	char *names = NULL;
+	char *name;
+	char *next;
+	int nfds;
+	int fd;
+	int i;
+
+	listen_pid = getenv("LISTEN_PID");
+	listen_fds = getenv("LISTEN_FDS");
+	if (!listen_pid || !listen_fds ||
+	    strtoul(listen_pid, NULL, 10) != getpid())
+		return 0;
+
+	nfds = atoi(listen_fds);
+	if (getenv("LISTEN_FDNAMES"))
+		names = strdup(getenv("LISTEN_FDNAMES"));
+
+	unsetenv("LISTEN_PID");
+	unsetenv("LISTEN_FDS");
+	unsetenv("LISTEN_FDNAMES");
+
+	name = names;
+	for (i = 0; i < nfds; i++) {
+		fd = LISTEN_FDS_START + i;
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+		next = name ? strchr(name, ':') : NULL;
+		if (next)
+			*next++ = '\0';
+
+		cb(fd, name ? name : "unknown", data);
+
+		name = next;
+	}
+
+	free(names);
+
+	return nfds;
+}
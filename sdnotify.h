@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __SDNOTIFY_H__
+#define __SDNOTIFY_H__
+
+#include <stdbool.h>
+
+typedef void (*sdnotify_listen_cb_t)(int fd, const char *name, void *data);
+
+bool sdnotify_available(void);
+int sdnotify(const char *state);
+int sdnotify_fds(const char *state, const int *fds, unsigned int nfds);
+int sdnotify_listen_fds(sdnotify_listen_cb_t cb, void *data);
+
+#endif
@@ -0,0 +1,410 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+/* For memfd_create, accept4 and struct ucred */
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <err.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "blockcache.h"
+#include "shmcache.h"
+
+/* Abstract socket through which instances hand out the region */
+#define SHMCACHE_SOCKET		"tqftpserv-shmcache"
+
+#define SHMCACHE_MAGIC		0x54514643	/* "TQFC" */
+#define SHMCACHE_VERSION	1
+#define SHMCACHE_SLOTS		1024
+#define SHMCACHE_ALIGN		4096
+
+#define CONNECT_RETRIES		10
+
+enum {
+	SLOT_FILLING,
+	SLOT_READY,
+	SLOT_FAILED,
+};
+
+/*
+ * A file in the region. @key is claimed with a compare-and-swap, after which
+ * the claiming instance owns the slot until it marks it ready, or failed.
+ */
+struct shmcache_slot {
+	_Atomic uint64_t key;
+	_Atomic uint32_t state;
+	uint64_t size;
+	uint64_t offset;
+};
+
+struct shmcache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t region_size;
+
+	/* Bump allocator, content is never freed */
+	_Atomic uint64_t used;
+
+	struct shmcache_slot slots[SHMCACHE_SLOTS];
+};
+
+static struct shmcache_header *region;
+static int region_fd = -1;
+
+static socklen_t shmcache_addr(struct sockaddr_un *addr)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	/* Leading NUL, for the abstract namespace */
+	memcpy(addr->sun_path + 1, SHMCACHE_SOCKET, strlen(SHMCACHE_SOCKET));
+
+	return offsetof(struct sockaddr_un, sun_path) + 1 + strlen(SHMCACHE_SOCKET);
+}
+
+static int shmcache_map(int fd)
+{
+	struct stat sb;
+	void *p;
+
+	if (fstat(fd, &sb) < 0 || sb.st_size < sizeof(*region))
+		return -1;
+
+	p = mmap(NULL, sb.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		return -1;
+
+	region = p;
+	if (region->magic != SHMCACHE_MAGIC ||
+	    region->version != SHMCACHE_VERSION ||
+	    region->region_size != sb.st_size) {
+		warnx("incompatible shared cache region");
+		munmap(p, sb.st_size);
+		region = NULL;
+		return -1;
+	}
+
+	region_fd = fd;
+
+	return 0;
+}
+
+static int shmcache_create(size_t size)
+{
+	uint64_t used;
+	int fd;
+
+	fd = memfd_create("tqftpserv-shmcache", MFD_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	if (ftruncate(fd, size) < 0)
+		goto err_close;
+
+	region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (region == MAP_FAILED) {
+		region = NULL;
+		goto err_close;
+	}
+
+	used = (sizeof(*region) + SHMCACHE_ALIGN - 1) & ~(uint64_t)(SHMCACHE_ALIGN - 1);
+
+	region->version = SHMCACHE_VERSION;
+	region->region_size = size;
+	atomic_init(&region->used, used);
+	region->magic = SHMCACHE_MAGIC;
+
+	region_fd = fd;
+
+	return 0;
+
+err_close:
+	close(fd);
+	return -1;
+}
+
+/* Receive the region from the instance listening on the socket */
+static int shmcache_receive(void)
+{
+	char control[CMSG_SPACE(sizeof(int))];
+	struct sockaddr_un addr;
+	struct cmsghdr *cmsg;
+	struct msghdr msg = {};
+	struct iovec iov;
+	socklen_t addrlen;
+	char dummy;
+	int retries;
+	int sock;
+	int fd;
+	int ret;
+
+	sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (sock < 0)
+		return -1;
+
+	addrlen = shmcache_addr(&addr);
+
+	/* The owner may have bound the socket but not yet be listening */
+	for (retries = 0; retries < CONNECT_RETRIES; retries++) {
+		ret = connect(sock, (struct sockaddr *)&addr, addrlen);
+		if (!ret || errno != ECONNREFUSED)
+			break;
+		usleep(10000);
+	}
+	if (ret < 0)
+		goto err_close;
+
+	iov.iov_base = &dummy;
+	iov.iov_len = sizeof(dummy);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) <= 0)
+		goto err_close;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (!cmsg || cmsg->cmsg_level != SOL_SOCKET ||
+	    cmsg->cmsg_type != SCM_RIGHTS)
+		goto err_close;
+
+	memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+	close(sock);
+
+	if (shmcache_map(fd) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return 0;
+
+err_close:
+	close(sock);
+	return -1;
+}
+
+/**
+ * shmcache_init() - share decompressed files with other instances
+ * @size:	size of the region to create, if no other instance provides one
+ *
+ * The first instance creates a memfd-backed region and hands it out over an
+ * abstract Unix socket, later instances map the same region. Instances
+ * started after the owner went away create a new region.
+ *
+ * Return: listening socket to pass to shmcache_handle(), -1 when another
+ * instance owns the region or on error
+ */
+int shmcache_init(size_t size)
+{
+	struct sockaddr_un addr;
+	socklen_t addrlen;
+	int sock;
+
+	if (size < sizeof(*region) + SHMCACHE_ALIGN) {
+		warnx("shared cache too small");
+		return -1;
+	}
+
+	sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (sock < 0) {
+		warn("failed to create shared cache socket");
+		return -1;
+	}
+
+	addrlen = shmcache_addr(&addr);
+	if (bind(sock, (struct sockaddr *)&addr, addrlen) < 0) {
+		close(sock);
+
+		if (errno != EADDRINUSE) {
+			warn("failed to bind shared cache socket");
+			return -1;
+		}
+
+		if (shmcache_receive() < 0)
+			warnx("failed to receive shared cache, not sharing");
+
+		return -1;
+	}
+
+	if (shmcache_create(size) < 0) {
+		warn("failed to create shared cache");
+		close(sock);
+		return -1;
+	}
+
+	if (listen(sock, 4) < 0) {
+		warn("failed to listen on shared cache socket");
+		close(sock);
+		return -1;
+	}
+
+	return sock;
+}
+
+/**
+ * shmcache_handle() - hand out the region to a connecting instance
+ * @sock:	listening socket returned by shmcache_init()
+ *
+ * Only processes running as the same user are given the region.
+ */
+void shmcache_handle(int sock)
+{
+	char control[CMSG_SPACE(sizeof(int))] = {};
+	struct cmsghdr *cmsg;
+	struct msghdr msg = {};
+	struct ucred cred;
+	socklen_t credlen = sizeof(cred);
+	struct iovec iov;
+	char dummy = 0;
+	int fd;
+
+	fd = accept4(sock, NULL, NULL, SOCK_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) < 0) {
+		close(fd);
+		return;
+	}
+
+	if (cred.uid != geteuid()) {
+		warnx("rejecting shared cache request from uid %d", cred.uid);
+		close(fd);
+		return;
+	}
+
+	iov.iov_base = &dummy;
+	iov.iov_len = sizeof(dummy);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &region_fd, sizeof(int));
+
+	if (sendmsg(fd, &msg, MSG_NOSIGNAL) < 0)
+		warn("failed to send shared cache");
+
+	close(fd);
+}
+
+static struct blockcache_file *shmcache_wrap(struct shmcache_slot *slot,
+					     size_t size)
+{
+	if (atomic_load_explicit(&slot->state, memory_order_acquire) != SLOT_READY ||
+	    slot->size != size)
+		return NULL;
+
+	return blockcache_wrap((char *)region + slot->offset, size);
+}
+
+/* Reserve @size bytes of the region, without going past its end */
+static int shmcache_alloc(size_t size, uint64_t *offset)
+{
+	uint64_t aligned = (size + SHMCACHE_ALIGN - 1) & ~(uint64_t)(SHMCACHE_ALIGN - 1);
+	uint64_t used = atomic_load_explicit(&region->used, memory_order_relaxed);
+
+	do {
+		if (used + aligned > region->region_size)
+			return -1;
+	} while (!atomic_compare_exchange_weak_explicit(&region->used, &used,
+							used + aligned,
+							memory_order_relaxed,
+							memory_order_relaxed));
+
+	*offset = used;
+
+	return 0;
+}
+
+static int shmcache_fill(struct shmcache_slot *slot, int fd, size_t size)
+{
+	size_t copied = 0;
+	uint64_t offset;
+	ssize_t n;
+
+	if (shmcache_alloc(size, &offset) < 0)
+		return -1;
+
+	while (copied < size) {
+		n = pread(fd, (char *)region + offset + copied, size - copied, copied);
+		if (n <= 0)
+			return -1;
+		copied += n;
+	}
+
+	slot->offset = offset;
+	slot->size = size;
+
+	return 0;
+}
+
+/**
+ * shmcache_get() - find, or add, a file in the shared region
+ * @fd:		memfd holding the decompressed file
+ * @hash:	hash of the content of @fd
+ * @size:	size of @fd
+ *
+ * The index is an open-addressed table, probed from @hash, in which slots are
+ * claimed with a compare-and-swap; so no lock is shared between instances.
+ * Content being filled in by another instance, or which didn't fit in the
+ * region, is treated as a miss, leaving the caller to keep its own copy.
+ *
+ * Return: in-memory file referring to the shared copy, NULL if not shared
+ */
+struct blockcache_file *shmcache_get(int fd, uint64_t hash, size_t size)
+{
+	struct shmcache_slot *slot;
+	uint64_t key = hash ? hash : 1;
+	uint64_t expected;
+	unsigned int i;
+
+	if (!region || !size)
+		return NULL;
+
+	for (i = 0; i < SHMCACHE_SLOTS; i++) {
+		slot = &region->slots[(hash + i) % SHMCACHE_SLOTS];
+
+		expected = atomic_load_explicit(&slot->key, memory_order_acquire);
+		if (expected == key)
+			return shmcache_wrap(slot, size);
+		if (expected)
+			continue;
+
+		if (atomic_compare_exchange_strong_explicit(&slot->key, &expected, key,
+							    memory_order_acq_rel,
+							    memory_order_acquire))
+			break;
+
+		/* Lost the race for this slot, to the same content perhaps */
+		if (expected == key)
+			return shmcache_wrap(slot, size);
+	}
+
+	if (i == SHMCACHE_SLOTS)
+		return NULL;
+
+	if (shmcache_fill(slot, fd, size) < 0) {
+		atomic_store_explicit(&slot->state, SLOT_FAILED, memory_order_release);
+		return NULL;
+	}
+
+	atomic_store_explicit(&slot->state, SLOT_READY, memory_order_release);
+
+	return shmcache_wrap(slot, size);
+}
@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __SHMCACHE_H__
+#define __SHMCACHE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "profile.h"
+
+struct blockcache_file;
+
+#if TQFTP_WITH_CACHE
+int shmcache_init(size_t size);
+void shmcache_handle(int sock);
+struct blockcache_file *shmcache_get(int fd, uint64_t hash, size_t size);
+#else
+static inline int shmcache_init(size_t size) { return -1; }
+static inline void shmcache_handle(int sock) {}
+#endif
+
+#endif
@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "startup.h"
+
+static bool startup_timing;
+static bool responded;
+static struct timespec main_entry;
+static struct timespec published;
+
+static double elapsed_ms(const struct timespec *from, const struct timespec *to)
+{
+	return (to->tv_sec - from->tv_sec) * 1000.0 +
+	       (to->tv_nsec - from->tv_nsec) / 1000000.0;
+}
+
+/* Time since boot at which the process was created, in ms, or -1 */
+static double process_start_ms(void)
+{
+	unsigned long long starttime;
+	char buf[1024];
+	size_t n;
+	char *p;
+	FILE *f;
+	int i;
+
+	f = fopen("/proc/self/stat", "r");
+	if (!f)
+		return -1;
+
+	n = fread(buf, 1, sizeof(buf) - 1, f);
+	fclose(f);
+	buf[n] = '\0';
+
+	/* The command name may contain spaces, fields are counted past it */
+	p = strrchr(buf, ')');
+	if (!p)
+		return -1;
+
+	/* starttime is field 22, the one after the command name being 3 */
+	for (i = 2; i < 22 && p; i++)
+		p = strchr(p + 1, ' ');
+	if (!p || sscanf(p + 1, "%llu", &starttime) != 1)
+		return -1;
+
+	return starttime * 1000.0 / sysconf(_SC_CLK_TCK);
+}
+
+/**
+ * startup_timing_enable() - report how long the service takes to come up
+ *
+ * To be called as early as possible in main().
+ */
+void startup_timing_enable(void)
+{
+	startup_timing = true;
+	clock_gettime(CLOCK_MONOTONIC, &main_entry);
+}
+
+/**
+ * startup_published() - the service was published
+ *
+ * Reports the time since the process was created, at the kernel's clock tick
+ * resolution, and since main() was entered.
+ */
+void startup_published(void)
+{
+	struct timespec boottime;
+	struct timespec now;
+	double start;
+
+	if (!startup_timing)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	clock_gettime(CLOCK_BOOTTIME, &boottime);
+	published = now;
+
+	start = process_start_ms();
+	if (start >= 0)
+		pr_info("startup: exec to publish %.1f ms",
+			boottime.tv_sec * 1000.0 + boottime.tv_nsec / 1000000.0 - start);
+	pr_info("startup: main to publish %.3f ms",
+		elapsed_ms(&main_entry, &now));
+}
+
+/**
+ * startup_responded() - a response was sent to a remote
+ *
+ * Reports the time from publication to the first response, only once.
+ */
+void startup_responded(void)
+{
+	struct timespec now;
+
+	if (!startup_timing || responded)
+		return;
+
+	responded = true;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pr_info("startup: publish to first response %.3f ms",
+		elapsed_ms(&published, &now));
+}
@@ -0,0 +1,13 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __STARTUP_H__
+#define __STARTUP_H__
+
+void startup_timing_enable(void);
+void startup_published(void);
+void startup_responded(void);
+
+#endif
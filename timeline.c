@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include <err.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "timeline.h"
+
+/* Completed timelines, only accessed from the main loop */
+static struct timeline ring[TIMELINE_RECORDS];
+static unsigned int ring_head;
+static unsigned int ring_count;
+
+/* Timeline phases marked by this thread are attributed to */
+static __thread struct timeline *current;
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * timeline_begin() - start the timeline of a transfer, at its request
+ * @tl:		timeline to start
+ * @node:	node of the remote
+ * @port:	port of the remote
+ * @filename:	file requested, only its end is kept if too long
+ * @write:	whether the remote writes the file
+ */
+void timeline_begin(struct timeline *tl, uint32_t node, uint32_t port,
+		    const char *filename, bool write)
+{
+	size_t len = strlen(filename);
+
+	memset(tl, 0, sizeof(*tl));
+	tl->phases[TIMELINE_REQUEST] = now_ns();
+	tl->node = node;
+	tl->port = port;
+	tl->write = write;
+
+	if (len >= TIMELINE_NAME_MAX)
+		filename += len - (TIMELINE_NAME_MAX - 1);
+	strcpy(tl->filename, filename);
+}
+
+/**
+ * timeline_attach() - attribute phases marked by this thread to a timeline
+ * @tl:		timeline to attribute phases to, NULL to stop
+ *
+ * For phases reached deep in code that doesn't know about the transfer,
+ * e.g. decompression in translate_open().
+ */
+void timeline_attach(struct timeline *tl)
+{
+	current = tl;
+}
+
+/**
+ * timeline_mark() - timestamp a phase of the attached timeline, if any
+ * @phase:	phase reached
+ */
+void timeline_mark(enum timeline_phase phase)
+{
+	if (current)
+		timeline_stamp(current, phase);
+}
+
+/**
+ * timeline_stamp() - timestamp a phase, unless already reached
+ * @tl:		timeline of the transfer
+ * @phase:	phase reached
+ */
+void timeline_stamp(struct timeline *tl, enum timeline_phase phase)
+{
+	if (!tl->phases[phase])
+		tl->phases[phase] = now_ns();
+}
+
+/**
+ * timeline_ack() - timestamp the acknowledgment of a window
+ * @tl:		timeline of the transfer
+ */
+void timeline_ack(struct timeline *tl)
+{
+	if (tl->nacks < TIMELINE_ACKS)
+		tl->acks[tl->nacks] = now_ns();
+	tl->nacks++;
+}
+
+/**
+ * timeline_end() - close the timeline of a transfer and keep it
+ * @tl:		timeline of the transfer
+ */
+void timeline_end(struct timeline *tl)
+{
+	if (!tl->phases[TIMELINE_REQUEST])
+		return;
+
+	timeline_stamp(tl, TIMELINE_CLOSED);
+
+	ring[ring_head] = *tl;
+	ring_head = (ring_head + 1) % TIMELINE_RECORDS;
+	if (ring_count < TIMELINE_RECORDS)
+		ring_count++;
+}
+
+/**
+ * timeline_dump() - write the completed timelines to a file
+ * @path:	file to write, replaced once complete
+ *
+ * Timelines are written oldest first, after a struct timeline_header.
+ *
+ * Return: number of timelines written, -1 on error
+ */
+int timeline_dump(const char *path)
+{
+	struct timeline_header hdr = {
+		.magic = TIMELINE_MAGIC,
+		.version = TIMELINE_VERSION,
+		.record_size = sizeof(struct timeline),
+		.count = ring_count,
+	};
+	char tmp[PATH_MAX];
+	unsigned int idx;
+	unsigned int i;
+	int ret;
+	FILE *f;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	f = fopen(tmp, "we");
+	if (!f) {
+		warn("failed to create %s", tmp);
+		return -1;
+	}
+
+	fwrite(&hdr, sizeof(hdr), 1, f);
+	for (i = 0; i < ring_count; i++) {
+		idx = (ring_head + TIMELINE_RECORDS - ring_count + i) % TIMELINE_RECORDS;
+		fwrite(&ring[idx], sizeof(ring[idx]), 1, f);
+	}
+
+	ret = ferror(f);
+	if (fclose(f) || ret || rename(tmp, path) < 0) {
+		warn("failed to write %s", path);
+		unlink(tmp);
+		return -1;
+	}
+
+	return ring_count;
+}
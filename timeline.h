@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __TIMELINE_H__
+#define __TIMELINE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef ANDROID
+#define TIMELINE_PATH		"/run/tqftpserv-timeline"
+#else
+#define TIMELINE_PATH		"/data/vendor/tmp/tqftpserv-timeline"
+#endif
+
+#define TIMELINE_MAGIC		0x7471746c	/* "tqtl" */
+#define TIMELINE_VERSION	1
+
+/* Completed timelines kept, the oldest being overwritten first */
+#define TIMELINE_RECORDS	256
+
+/* Window ACKs timestamped per transfer, later ones are only counted */
+#define TIMELINE_ACKS		32
+
+#define TIMELINE_NAME_MAX	96
+
+enum timeline_phase {
+	TIMELINE_REQUEST,
+	TIMELINE_RESOLVED,
+	TIMELINE_DECOMPRESSED,
+	TIMELINE_CONNECTED,
+	TIMELINE_FIRST_SENT,
+	TIMELINE_CLOSED,
+	TIMELINE_NR_PHASES,
+};
+
+/*
+ * Phases of one transfer, as CLOCK_MONOTONIC times in ns, 0 for phases not
+ * reached. Written as is to the dump file, following its header.
+ */
+struct timeline {
+	uint64_t phases[TIMELINE_NR_PHASES];
+	uint64_t acks[TIMELINE_ACKS];
+	uint32_t nacks;
+
+	uint32_t node;
+	uint32_t port;
+	uint32_t write;
+
+	char filename[TIMELINE_NAME_MAX];
+};
+
+struct timeline_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t count;
+};
+
+void timeline_begin(struct timeline *tl, uint32_t node, uint32_t port,
+		    const char *filename, bool write);
+void timeline_attach(struct timeline *tl);
+void timeline_mark(enum timeline_phase phase);
+void timeline_stamp(struct timeline *tl, enum timeline_phase phase);
+void timeline_ack(struct timeline *tl);
+void timeline_end(struct timeline *tl);
+int timeline_dump(const char *path);
+
+#endif
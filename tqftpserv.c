@@ -2,23 +2,68 @@
 /*
  * Copyright (c) 2018, Linaro Ltd.
  */
+
+/* For sync_file_range */
+#define _GNU_SOURCE
+
 #include <arpa/inet.h>
 #include <sys/stat.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <libgen.h>
 #include <libqrtr.h>
+#include <limits.h>
+#include <signal.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <syslog.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "admission.h"
+#include "blockcache.h"
+#include "bootprofile.h"
+#include "cache.h"
+#include "config.h"
+#include "control.h"
+#include "fdstore.h"
+#include "handoff.h"
+#include "heatmap.h"
 #include "list.h"
+#include "logger.h"
+#include "membudget.h"
+#include "metrics.h"
+#include "predict.h"
+#include "prefetch.h"
+#include "probes.h"
+#include "profile.h"
+#include "profiler.h"
+#include "remoteproc.h"
+#include "rt.h"
+#include "sdnotify.h"
+#include "shmcache.h"
+#include "startup.h"
+#include "timeline.h"
 #include "translate.h"
+#include "writeback.h"
 #include "zstd-decompress.h"
 
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 
+/* Uploads are written back and dropped from the page cache in chunks of this size */
+#define WRITEBACK_CHUNK	(1024 * 1024)
+
+/* Cache budget used for prefetching, unless specified */
+#define DEFAULT_CACHE_SIZE	(64 * 1024 * 1024)
+
+/* Clients preallocated in real-time mode, each able to send TQFTP_MAX_BLKSIZE */
+#define RT_POOL_CLIENTS		16
+
+/* Remote nodes served at once in real-time mode, each up to its session limit */
+#define RT_POOL_NODES		8
+
 enum {
 	OP_RRQ = 1,
 	OP_WRQ,
@@ -40,27 +85,232 @@ struct tftp_client {
 	int sock;
 	int fd;
 
+	/* As requested by the remote, to reopen the file after a handoff */
+	char *filename;
+
+	/* Preallocated, for DATA packets to be built without allocating */
+	char *buf;
+	size_t bufsize;
+
+	/* Size of the decompressed copy accounted for admission, if any */
+	size_t charged;
+
+	/* Set instead of fd when reading from a compressed in-memory copy */
+	struct blockcache_file *blocks;
+	struct blockcache_cursor cursor;
+
 	size_t block;
 
+	ssize_t tsize;
 	size_t blksize;
 	size_t rsize;
 	size_t wsize;
 	unsigned int timeoutms;
 	off_t seek;
+
+	/* The OACK is sent again until the remote answers it */
+	bool oack_pending;
+
+	/* Size of the file being read, and when the transfer started */
+	size_t size;
+	struct timespec started;
+
+	/*
+	 * Last block acknowledged, and when the window following it was sent;
+	 * for writers, when the OACK or the ACK of the WRQ was sent.
+	 */
+	uint16_t acked;
+	struct timespec sent;
+	bool awaiting_ack;
+	unsigned int retries;
+
+	off_t written;
+	off_t synced;
+	bool no_writeback;
+
+	struct timeline timeline;
+
+	/* Access statistics of the file, NULL if not tracked */
+	struct heatmap_file *heat;
+};
+
+/* A read or write request, as parsed from the remote's packet */
+struct tftp_request {
+	int opcode;
+	bool do_oack;
+
+	ssize_t tsize;
+	size_t blksize;
+	unsigned int timeoutms;
+	size_t rsize;
+	size_t wsize;
+	off_t seek;
+
+	/* Started on receipt, so that time waiting for admission shows */
+	struct timeline timeline;
+
+	/* Only the used part is kept while waiting for admission */
+	char filename[PATH_MAX];
 };
 
+static struct tqftp_config config = {
+	.blksize = 512,
+	.timeoutms = 1000,
+	.max_blksize = TQFTP_MAX_BLKSIZE,
+	.max_wsize = TQFTP_MAX_WSIZE,
+	.cache_size = -1,
+	.log_level = LOG_INFO,
+};
+
+static volatile sig_atomic_t reload_requested;
+static volatile sig_atomic_t profile_requested;
+static volatile sig_atomic_t terminate_requested;
+
 static struct list_head readers = LIST_INIT(readers);
 static struct list_head writers = LIST_INIT(writers);
 
+/* Free clients, kept around in real-time mode and with fixed capacities */
+static struct list_head client_pool = LIST_INIT(client_pool);
+
+#if TQFTP_MAX_CLIENTS
+static struct tftp_client client_slots[TQFTP_MAX_CLIENTS];
+static char client_bufs[TQFTP_MAX_CLIENTS][4 + TQFTP_MAX_BLKSIZE];
+#endif
+
+static struct tftp_client *client_new(size_t bufsize)
+{
+	struct tftp_client *client;
+
+	client = calloc(1, sizeof(*client));
+	if (!client)
+		return NULL;
+
+	client->buf = malloc(bufsize);
+	if (!client->buf) {
+		free(client);
+		return NULL;
+	}
+	client->bufsize = bufsize;
+
+	return client;
+}
+
+/**
+ * client_alloc() - allocate a client, from the pool if possible
+ * @blksize:	block size negotiated for the transfer
+ *
+ * Return: zeroed client with a send buffer for @blksize, NULL on error
+ */
+static struct tftp_client *client_alloc(size_t blksize)
+{
+	struct tftp_client *client = NULL;
+
+	if (!list_empty(&client_pool) && blksize <= TQFTP_MAX_BLKSIZE) {
+		client = list_entry_first(&client_pool, struct tftp_client, node);
+		list_del(&client->node);
+	} else if (TQFTP_MAX_CLIENTS || rt_active()) {
+		/* All static, or preallocated, clients are in use */
+		return NULL;
+	} else {
+		client = client_new(4 + blksize);
+		if (!client)
+			return NULL;
+	}
+
+	membudget_account(MEMBUDGET_TRANSFERS, sizeof(*client) + client->bufsize);
+
+	return client;
+}
+
+static void client_release(struct tftp_client *client)
+{
+	char *buf = client->buf;
+	size_t bufsize = client->bufsize;
+
+	membudget_account(MEMBUDGET_TRANSFERS,
+			  -(ssize_t)(sizeof(*client) + client->bufsize));
+	free(client->filename);
+
+	if (!TQFTP_MAX_CLIENTS &&
+	    (!rt_active() || bufsize != 4 + TQFTP_MAX_BLKSIZE)) {
+		free(client->buf);
+		free(client);
+		return;
+	}
+
+	memset(client, 0, sizeof(*client));
+	client->buf = buf;
+	client->bufsize = bufsize;
+	list_add(&client_pool, &client->node);
+}
+
+#if TQFTP_MAX_CLIENTS
+/* With fixed capacities, the static clients are the only ones there are */
+static void client_slots_init(void)
+{
+	int i;
+
+	for (i = 0; i < TQFTP_MAX_CLIENTS; i++) {
+		client_slots[i].buf = client_bufs[i];
+		client_slots[i].bufsize = sizeof(client_bufs[i]);
+		list_add(&client_pool, &client_slots[i].node);
+	}
+}
+#endif
+
+/*
+ * Preallocate clients, and their send buffers, for real-time mode. These are
+ * the only clients there are from then on, requests beyond are refused.
+ *
+ * Return: 0 on success, -1 if out of memory
+ */
+static int client_pool_fill(unsigned int n)
+{
+	struct tftp_client *client;
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		client = client_new(4 + TQFTP_MAX_BLKSIZE);
+		if (!client)
+			return -1;
+
+		/* Touch the buffer, it's locked in memory from here on */
+		memset(client->buf, 0, client->bufsize);
+		list_add(&client_pool, &client->node);
+	}
+
+	return 0;
+}
+
+static long elapsed_ms(const struct timespec *since)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - since->tv_sec) * 1000 +
+	       (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+static long elapsed_us(const struct timespec *since)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - since->tv_sec) * 1000000 +
+	       (now.tv_nsec - since->tv_nsec) / 1000;
+}
+
 static ssize_t tftp_send_data(struct tftp_client *client,
 			      unsigned int block, size_t offset, size_t response_size)
 {
+	struct profiler_span span;
 	ssize_t len;
 	size_t send_len;
-	char *buf;
+	char *buf = client->buf;
 	char *p;
 
-	buf = malloc(4 + client->blksize);
 	p = buf;
 
 	*p++ = 0;
@@ -69,10 +319,16 @@ static ssize_t tftp_send_data(struct tftp_client *client,
 	*p++ = (block >> 8) & 0xff;
 	*p++ = block & 0xff;
 
-	len = pread(client->fd, p, client->blksize, offset);
+	profiler_begin(&span);
+	if (client->blocks)
+		len = blockcache_read(client->blocks, &client->cursor, p,
+				      client->blksize, offset);
+	else
+		len = pread(client->fd, p, client->blksize, offset);
+	profiler_end(&span, PROFILER_READ, client->filename, client->sq.sq_node,
+		     len > 0 ? len : 0);
 	if (len < 0) {
-		printf("[TQFTP] failed to read data\n");
-		free(buf);
+		pr_err("failed to read data of %s", client->filename);
 		return len;
 	}
 
@@ -83,8 +339,8 @@ static ssize_t tftp_send_data(struct tftp_client *client,
 		/* Header (4 bytes) + data size */
 		send_len = 4 + response_size;
 		if (send_len > p - buf) {
-			printf("[TQFTP] requested data of %ld bytes but only read %ld bytes from file, rejecting\n", response_size, len);
-			free(buf);
+			pr_warn("requested data of %zu bytes but only read %zd bytes from file, rejecting",
+				response_size, len);
 			return -EINVAL;
 		}
 	} else {
@@ -92,9 +348,19 @@ static ssize_t tftp_send_data(struct tftp_client *client,
 	}
 
 	// printf("[TQFTP] Sending %zd bytes of DATA\n", send_len);
+	profiler_begin(&span);
 	len = send(client->sock, buf, send_len, 0);
+	profiler_end(&span, PROFILER_SEND, client->filename, client->sq.sq_node, 0);
+	if (len < 0)
+		return len;
 
-	free(buf);
+	heatmap_read(client->heat, offset, len - 4);
+	metrics_add(METRICS_BYTES_SENT, len - 4);
+	metrics_add(METRICS_BLOCKS_SENT, 1);
+	/* The send, and the pread unless served from the block cache */
+	metrics_add(METRICS_SYSCALLS, client->blocks ? 1 : 2);
+	TQFTP_PROBE4(data__send, client->sq.sq_node, client->sq.sq_port,
+		     block, len - 4);
 
 	return len;
 }
@@ -178,25 +444,34 @@ static int tftp_send_oack(int sock, size_t *blocksize, size_t *tsize,
 	return send(sock, buf, p - buf, 0);
 }
 
+static void tftp_send_client_oack(struct tftp_client *client)
+{
+	tftp_send_oack(client->sock, &client->blksize,
+		       client->tsize ? (size_t *)&client->tsize : NULL,
+		       client->wsize ? &client->wsize : NULL,
+		       &client->timeoutms,
+		       client->rsize ? &client->rsize : NULL,
+		       client->seek ? &client->seek : NULL);
+}
+
 static int tftp_send_error(int sock, int code, const char *msg)
 {
+	char buf[128];
 	size_t len;
-	char *buf;
-	int rc;
-
-	len = 4 + strlen(msg) + 1;
 
-	buf = calloc(1, len);
-	if (!buf)
-		return -1;
+	len = strlen(msg);
+	if (len > sizeof(buf) - 5)
+		len = sizeof(buf) - 5;
 
 	*(uint16_t*)buf = htons(OP_ERROR);
 	*(uint16_t*)(buf + 2) = htons(code);
-	strcpy(buf + 4, msg);
+	memcpy(buf + 4, msg, len);
+	buf[4 + len] = '\0';
+
+	if (code >= 0 && code < METRICS_NR_COUNTERS - METRICS_ERRORS)
+		metrics_add(METRICS_ERRORS + code, 1);
 
-	rc = send(sock, buf, len, 0);
-	free(buf);
-	return rc;
+	return send(sock, buf, 4 + len + 1, 0);
 }
 
 static void parse_options(const char *buf, size_t len, size_t *blksize,
@@ -225,6 +500,8 @@ static void parse_options(const char *buf, size_t len, size_t *blksize,
 		 */
 		if (!strcmp(opt, "blksize")) {
 			*blksize = atoi(value);
+			if (*blksize > config.max_blksize)
+				*blksize = config.max_blksize;
 		} else if (!strcmp(opt, "timeoutms")) {
 			*timeoutms = atoi(value);
 		} else if (!strcmp(opt, "tsize")) {
@@ -233,213 +510,327 @@ static void parse_options(const char *buf, size_t len, size_t *blksize,
 			*rsize = atoi(value);
 		} else if (!strcmp(opt, "wsize")) {
 			*wsize = atoi(value);
+			if (config.max_wsize && *wsize > config.max_wsize)
+				*wsize = config.max_wsize;
 		} else if (!strcmp(opt, "seek")) {
 			*seek = atoi(value);
 		} else {
-			printf("[TQFTP] Ignoring unknown option '%s' with value '%s'\n", opt, value);
+			pr_debug("Ignoring unknown option '%s' with value '%s'", opt, value);
 		}
 	}
 }
 
-static void handle_rrq(const char *buf, size_t len, struct sockaddr_qrtr *sq)
+/* Decompressed copies charged to the read request being handled */
+static size_t rrq_charged;
+static bool rrq_over_budget;
+
+/* Charge a file about to be decompressed for a read request, see handle_rrq() */
+static int tftp_charge(size_t bytes)
 {
-	struct tftp_client *client;
-	const char *filename;
-	const char *mode;
-	struct stat sb;
-	const char *p;
-	ssize_t tsize = -1;
-	size_t blksize = 512;
-	unsigned int timeoutms = 1000;
-	size_t rsize = 0;
-	size_t wsize = 0;
-	off_t seek = 0;
-	bool do_oack = false;
-	int sock;
-	int ret;
-	int fd;
+	if (admission_charge(bytes) < 0) {
+		rrq_over_budget = true;
+		return -1;
+	}
 
-	p = buf + 2;
+	rrq_charged += bytes;
 
-	filename = p;
-	p += strlen(p) + 1;
+	return 0;
+}
 
-	mode = p;
-	p += strlen(p) + 1;
+/* Send the window of blocks following @last, the last block acknowledged */
+static void tftp_send_window(struct tftp_client *client, uint16_t last)
+{
+	/* Without a window negotiated, a block at a time */
+	size_t wsize = client->wsize ? client->wsize : 1;
+	uint16_t block;
+	ssize_t n;
 
-	if (strcasecmp(mode, "octet")) {
-		/* XXX: error */
-		printf("[TQFTP] not octet, reject\n");
-		return;
-	}
+	for (block = last; block < last + wsize; block++) {
+		size_t offset = client->seek + block * client->blksize;
+		size_t response_size = 0;
+		/* Check if need to limit response size based for requested rsize */
+		if ((block + 1) * client->blksize > client->rsize)
+			response_size = client->rsize % client->blksize;
 
-	if (p < buf + len) {
-		do_oack = true;
-		parse_options(p, len - (p - buf), &blksize, &tsize, &wsize,
-				&timeoutms, &rsize, &seek);
+		n = tftp_send_data(client, block + 1,
+				   offset, response_size);
+		if (n < 0) {
+			pr_err("Sent block %d failed: %zd", block + 1, n);
+			break;
+		}
+		// printf("[TQFTP] Sent block %d of %zd\n", block + 1, n);
+		if (n == 0)
+			break;
+		/* We've sent enough data for rsize already */
+		if ((block + 1) * client->blksize > client->rsize)
+			break;
 	}
 
-	printf("[TQFTP] RRQ: %s (mode=%s rsize=%ld seek=%ld)\n", filename, mode, rsize, seek);
+	client->acked = last;
+	client->awaiting_ack = true;
+	clock_gettime(CLOCK_MONOTONIC, &client->sent);
+}
+
+/* Return: 0 once handled, -EAGAIN if the request isn't admitted yet */
+static int handle_rrq(const struct tftp_request *req, struct sockaddr_qrtr *sq)
+{
+	const char *filename = req->filename;
+	struct timeline tl = req->timeline;
+	struct blockcache_file *blocks;
+	struct tftp_client *client;
+	struct timespec start;
+	size_t size;
+	struct stat sb;
+	size_t charged;
+	bool cached;
+	ssize_t tsize = req->tsize;
+	size_t blksize = req->blksize;
+	size_t rsize = req->rsize;
+	size_t wsize = req->wsize;
+	off_t seek = req->seek;
+	int sock;
+	int ret;
+	int fd;
+
+	if (admission_begin(sq->sq_node) < 0)
+		return -EAGAIN;
 
 	sock = qrtr_open(0);
 	if (sock < 0) {
 		/* XXX: error */
-		printf("[TQFTP] unable to create new qrtr socket, reject\n");
-		return;
+		pr_err("unable to create new qrtr socket, reject");
+		admission_end(sq->sq_node, 0);
+		return 0;
 	}
 
 	ret = connect(sock, (struct sockaddr *)sq, sizeof(*sq));
 	if (ret < 0) {
 		/* XXX: error */
-		printf("[TQFTP] unable to connect new qrtr socket to remote\n");
-		return;
+		pr_err("unable to connect new qrtr socket to remote");
+		admission_end(sq->sq_node, 0);
+		return 0;
+	}
+	timeline_stamp(&tl, TIMELINE_CONNECTED);
+
+	/*
+	 * Files decompressed for this request are charged before being
+	 * decompressed, from the size recorded in their zstd frame, so that
+	 * requests over the budget wait without having spent the memory.
+	 * Copies already cached aren't charged again.
+	 */
+	rrq_charged = 0;
+	rrq_over_budget = false;
+	zstd_attach_charge(tftp_charge);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	timeline_attach(&tl);
+	profiler_attach(filename, sq->sq_node);
+	cached = cache_open(filename, &fd, &blocks) == 0;
+	if (!cached) {
+		fd = translate_open(filename, O_RDONLY);
+		if (fd >= 0 && translate_cacheable(filename))
+			cache_insert(filename, fd);
+	}
+	profiler_attach(NULL, -1);
+	timeline_attach(NULL);
+	zstd_attach_charge(NULL);
+	charged = rrq_charged;
+
+	if (fd < 0 && !blocks && rrq_over_budget) {
+		close(sock);
+		admission_abort(sq->sq_node, charged);
+		return -EAGAIN;
 	}
 
-	fd = translate_open(filename, O_RDONLY);
-	if (fd < 0) {
-		printf("[TQFTP] unable to open %s (%d), reject\n", filename, errno);
+	metrics_add(cached ? METRICS_CACHE_HITS : METRICS_CACHE_MISSES, 1);
+	timeline_stamp(&tl, TIMELINE_RESOLVED);
+	if (fd < 0 && !blocks) {
+		pr_info("unable to open %s (%d), reject", filename, errno);
 		tftp_send_error(sock, 1, "file not found");
-		return;
+		startup_responded();
+		admission_end(sq->sq_node, charged);
+		timeline_end(&tl);
+		return 0;
 	}
+	metrics_time(METRICS_OPEN, &start);
 
-	if (tsize != -1) {
+	if (blocks) {
+		size = blockcache_size(blocks);
+	} else {
 		fstat(fd, &sb);
-		tsize = sb.st_size;
+		size = sb.st_size;
 	}
 
-	client = calloc(1, sizeof(*client));
+	if (tsize != -1)
+		tsize = size;
+
+	bootprofile_record(sq->sq_node, filename, seek, rsize);
+	predict_record(sq->sq_node, filename, size);
+
+	client = client_alloc(blksize);
+	if (!client) {
+		pr_err("unable to allocate client, reject");
+		tftp_send_error(sock, 0, "out of memory");
+		if (blocks)
+			blockcache_put(blocks);
+		else
+			translate_close(fd);
+		close(sock);
+		admission_end(sq->sq_node, charged);
+		return 0;
+	}
 	client->sq = *sq;
 	client->sock = sock;
 	client->fd = fd;
+	client->filename = strdup(filename);
+	client->size = size;
+	clock_gettime(CLOCK_MONOTONIC, &client->started);
+	client->timeline = tl;
+	client->charged = charged;
+	client->blocks = blocks;
+	if (blocks)
+		blockcache_cursor_init(blocks, &client->cursor);
+	client->tsize = tsize;
 	client->blksize = blksize;
 	client->rsize = rsize;
 	client->wsize = wsize;
-	client->timeoutms = timeoutms;
+	client->timeoutms = req->timeoutms;
 	client->seek = seek;
+	client->heat = heatmap_request(filename, sq->sq_node, seek, rsize, size);
 
 	// printf("[TQFTP] new reader added\n");
 
 	list_add(&readers, &client->node);
 
-	if (do_oack) {
-		tftp_send_oack(client->sock, &blksize,
-			       tsize ? (size_t*)&tsize : NULL,
-			       wsize ? &wsize : NULL,
-			       &client->timeoutms,
-			       rsize ? &rsize : NULL,
-			       seek ? &seek : NULL);
+	if (req->do_oack) {
+		tftp_send_client_oack(client);
+		client->oack_pending = true;
+		client->awaiting_ack = true;
+		clock_gettime(CLOCK_MONOTONIC, &client->sent);
 	} else {
-		tftp_send_data(client, 1, 0, 0);
+		tftp_send_window(client, 0);
 	}
+	timeline_stamp(&client->timeline, TIMELINE_FIRST_SENT);
+
+	startup_responded();
+
+	return 0;
 }
 
-static void handle_wrq(const char *buf, size_t len, struct sockaddr_qrtr *sq)
+/* Return: 0 once handled, -EAGAIN if the request isn't admitted yet */
+static int handle_wrq(const struct tftp_request *req, struct sockaddr_qrtr *sq)
 {
+	const char *filename = req->filename;
+	struct timeline tl = req->timeline;
 	struct tftp_client *client;
-	const char *filename;
-	const char *mode;
-	const char *p;
-	ssize_t tsize = -1;
-	size_t blksize = 512;
-	unsigned int timeoutms = 1000;
-	size_t rsize = 0;
-	size_t wsize = 0;
-	off_t seek = 0;
-	bool do_oack = false;
+	ssize_t tsize = req->tsize;
+	size_t blksize = req->blksize;
+	size_t rsize = req->rsize;
+	size_t wsize = req->wsize;
+	off_t seek = req->seek;
 	int sock;
 	int ret;
 	int fd;
 
-	filename = buf + 2;
-	mode = buf + 2 + strlen(filename) + 1;
-	p = mode + strlen(mode) + 1;
-
-	if (strcasecmp(mode, "octet")) {
-		/* XXX: error */
-		printf("[TQFTP] not octet, reject\n");
-		return;
-	}
-
-	printf("[TQFTP] WRQ: %s (%s)\n", filename, mode);
-
-	if (p < buf + len) {
-		do_oack = true;
-		parse_options(p, len - (p - buf), &blksize, &tsize, &wsize,
-				&timeoutms, &rsize, &seek);
-	}
+	if (admission_begin(sq->sq_node) < 0)
+		return -EAGAIN;
 
+	profiler_attach(filename, sq->sq_node);
 	fd = translate_open(filename, O_WRONLY | O_CREAT);
+	profiler_attach(NULL, -1);
+	timeline_stamp(&tl, TIMELINE_RESOLVED);
 	if (fd < 0) {
 		/* XXX: error */
-		printf("[TQFTP] unable to open %s (%d), reject\n", filename, errno);
-		return;
+		pr_info("unable to open %s (%d), reject", filename, errno);
+		admission_end(sq->sq_node, 0);
+		return 0;
 	}
 
 	sock = qrtr_open(0);
 	if (sock < 0) {
 		/* XXX: error */
-		printf("[TQFTP] unable to create new qrtr socket, reject\n");
-		return;
+		pr_err("unable to create new qrtr socket, reject");
+		admission_end(sq->sq_node, 0);
+		return 0;
 	}
 
 	ret = connect(sock, (struct sockaddr *)sq, sizeof(*sq));
 	if (ret < 0) {
 		/* XXX: error */
-		printf("[TQFTP] unable to connect new qrtr socket to remote\n");
-		return;
+		pr_err("unable to connect new qrtr socket to remote");
+		admission_end(sq->sq_node, 0);
+		return 0;
+	}
+	timeline_stamp(&tl, TIMELINE_CONNECTED);
+
+	client = client_alloc(blksize);
+	if (!client) {
+		pr_err("unable to allocate client, reject");
+		tftp_send_error(sock, 0, "out of memory");
+		translate_close(fd);
+		close(sock);
+		admission_end(sq->sq_node, 0);
+		return 0;
 	}
-
-	client = calloc(1, sizeof(*client));
 	client->sq = *sq;
 	client->sock = sock;
 	client->fd = fd;
+	client->filename = strdup(filename);
+	clock_gettime(CLOCK_MONOTONIC, &client->started);
+	client->timeline = tl;
+	client->tsize = tsize;
 	client->blksize = blksize;
 	client->rsize = rsize;
 	client->wsize = wsize;
-	client->timeoutms = timeoutms;
+	client->timeoutms = req->timeoutms;
 	client->seek = seek;
 
 	// printf("[TQFTP] new writer added\n");
 
 	list_add(&writers, &client->node);
 
-	if (do_oack) {
-		tftp_send_oack(client->sock, &blksize,
-			       tsize ? (size_t*)&tsize : NULL,
-			       wsize ? &wsize : NULL,
-			       &client->timeoutms,
-			       rsize ? &rsize : NULL,
-			       seek ? &seek : NULL);
+	if (req->do_oack) {
+		tftp_send_client_oack(client);
+		client->oack_pending = true;
 	} else {
-		tftp_send_data(client, 1, 0, 0);
+		tftp_send_ack(client->sock, 0);
 	}
+	client->awaiting_ack = true;
+	clock_gettime(CLOCK_MONOTONIC, &client->sent);
+	timeline_stamp(&client->timeline, TIMELINE_FIRST_SENT);
+
+	startup_responded();
+
+	return 0;
 }
 
 static int handle_reader(struct tftp_client *client)
 {
+	struct profiler_span span;
 	struct sockaddr_qrtr sq;
-	uint16_t block;
 	uint16_t last;
 	char buf[128];
 	socklen_t sl;
 	ssize_t len;
-	ssize_t n = 0;
 	int opcode;
 	int ret;
 
 	sl = sizeof(sq);
+	profiler_begin(&span);
 	len = recvfrom(client->sock, buf, sizeof(buf), 0, (void *)&sq, &sl);
+	profiler_end(&span, PROFILER_RECEIVE, client->filename, client->sq.sq_node, 0);
 	if (len < 0) {
 		ret = -errno;
 		if (ret != -ENETRESET)
-			fprintf(stderr, "[TQFTP] recvfrom failed: %d\n", ret);
+			pr_err("recvfrom failed: %d", ret);
 		return -1;
 	}
+	metrics_add(METRICS_SYSCALLS, 1);
 
 	/* Drop unsolicited messages */
 	if (sq.sq_node != client->sq.sq_node ||
 	    sq.sq_port != client->sq.sq_port) {
-		printf("[TQFTP] Discarding spoofed message\n");
+		pr_warn("Discarding spoofed message");
 		return -1;
 	}
 
@@ -449,63 +840,85 @@ static int handle_reader(struct tftp_client *client)
 		int err = buf[2] << 8 | buf[3];
 		/* "End of Transfer" is not an error, used with stat(2)-like calls */
 		if (err == ERROR_END_OF_TRANSFER)
-			printf("[TQFTP] Remote returned END OF TRANSFER: %d - %s\n", err, buf + 4);
+			pr_debug("Remote returned END OF TRANSFER: %d - %s", err, buf + 4);
 		else
-			printf("[TQFTP] Remote returned an error: %d - %s\n", err, buf + 4);
+			pr_warn("Remote returned an error: %d - %s", err, buf + 4);
 		return -1;
 	} else if (opcode != OP_ACK) {
-		printf("[TQFTP] Expected ACK, got %d\n", opcode);
+		pr_warn("Expected ACK, got %d", opcode);
 		return -1;
 	}
 
 	last = buf[2] << 8 | buf[3];
 	// printf("[TQFTP] Got ack for %d\n", last);
+	timeline_ack(&client->timeline);
+	if (TQFTP_PROBE_ENABLED(ack))
+		TQFTP_PROBE4(ack, sq.sq_node, sq.sq_port, last,
+			     elapsed_us(&client->sent));
 
 	/* We've sent enough data for rsize already */
 	if (last * client->blksize > client->rsize)
 		return 0;
 
-	for (block = last; block < last + client->wsize; block++) {
-		size_t offset = client->seek + block * client->blksize;
-		size_t response_size = 0;
-		/* Check if need to limit response size based for requested rsize */
-		if ((block + 1) * client->blksize > client->rsize)
-			response_size = client->rsize % client->blksize;
+	client->retries = 0;
+	client->oack_pending = false;
+	tftp_send_window(client, last);
 
-		n = tftp_send_data(client, block + 1,
-				   offset, response_size);
-		if (n < 0) {
-			printf("[TQFTP] Sent block %d failed: %zd\n", block + 1, n);
-			break;
+	return 1;
+}
+
+/**
+ * tftp_writeback() - write back and drop completed chunks of an upload
+ * @client:	writer to write back data for
+ *
+ * Rather than leaving large uploads for the kernel's global writeback, start
+ * writeback of each chunk as soon as it is complete and drop the chunk before
+ * it from the page cache, once written. This bounds the dirty memory of each
+ * upload to a couple of chunks. Waiting for the chunk before is left to the
+ * writeback thread, the main loop doesn't wait on the disk.
+ */
+static void tftp_writeback(struct tftp_client *client)
+{
+	off_t start;
+
+	while (!client->no_writeback &&
+	       client->synced + WRITEBACK_CHUNK <= client->written) {
+		start = client->synced;
+
+		if (writeback_start(client->fd, start, WRITEBACK_CHUNK) < 0) {
+			/* Not backed by a regular file, don't try again */
+			client->no_writeback = true;
+			return;
 		}
-		// printf("[TQFTP] Sent block %d of %zd\n", block + 1, n);
-		if (n == 0)
-			break;
-		/* We've sent enough data for rsize already */
-		if ((block + 1) * client->blksize > client->rsize)
-			break;
-	}
 
-	return 1;
+		if (start >= WRITEBACK_CHUNK)
+			writeback_drop(client->fd, start - WRITEBACK_CHUNK,
+				       WRITEBACK_CHUNK);
+
+		client->synced += WRITEBACK_CHUNK;
+	}
 }
 
 static int handle_writer(struct tftp_client *client)
 {
+	struct profiler_span span;
 	struct sockaddr_qrtr sq;
+	char *buf = client->buf;
 	uint16_t block;
 	size_t payload;
-	char buf[516];
 	socklen_t sl;
 	ssize_t len;
 	int opcode;
 	int ret;
 
 	sl = sizeof(sq);
-	len = recvfrom(client->sock, buf, sizeof(buf), 0, (void *)&sq, &sl);
+	profiler_begin(&span);
+	len = recvfrom(client->sock, buf, 4 + client->blksize, 0,
+		       (void *)&sq, &sl);
 	if (len < 0) {
 		ret = -errno;
 		if (ret != -ENETRESET)
-			fprintf(stderr, "[TQFTP] recvfrom failed: %d\n", ret);
+			pr_err("recvfrom failed: %d", ret);
 		return -1;
 	}
 
@@ -517,90 +930,1173 @@ static int handle_writer(struct tftp_client *client)
 	opcode = buf[0] << 8 | buf[1];
 	block = buf[2] << 8 | buf[3];
 	if (opcode != OP_DATA) {
-		printf("[TQFTP] Expected DATA opcode, got %d\n", opcode);
+		pr_warn("Expected DATA opcode, got %d", opcode);
 		tftp_send_error(client->sock, 4, "Expected DATA opcode");
 		return -1;
 	}
 
+	/* The remote's DATA answers the OACK, or the ACK of the WRQ */
+	client->oack_pending = false;
+	client->awaiting_ack = false;
+
 	payload = len - 4;
 
 	ret = write(client->fd, buf + 4, payload);
+	/* The recvfrom and the write, as the DATA is checked in between */
+	profiler_end(&span, PROFILER_RECEIVE, client->filename, client->sq.sq_node,
+		     ret > 0 ? ret : 0);
 	if (ret < 0) {
 		/* XXX: report error */
-		printf("[TQFTP] failed to write data\n");
+		pr_err("failed to write data of %s", client->filename);
 		return -1;
 	}
 
+	client->written += ret;
+	tftp_writeback(client);
+
 	tftp_send_ack(client->sock, block);
+	timeline_ack(&client->timeline);
 
-	return payload == 512 ? 1 : 0;
+	metrics_add(METRICS_BYTES_RECEIVED, ret);
+	metrics_add(METRICS_BLOCKS_RECEIVED, 1);
+	/* The recvfrom, the write and the send of the ACK */
+	metrics_add(METRICS_SYSCALLS, 3);
+
+	return payload == client->blksize ? 1 : 0;
 }
 
 static void client_close_and_free(struct tftp_client *client)
 {
+	admission_end(client->sq.sq_node, client->charged);
+	timeline_end(&client->timeline);
+	if (TQFTP_PROBE_ENABLED(client__close))
+		TQFTP_PROBE4(client__close, client->sq.sq_node,
+			     client->sq.sq_port,
+			     client->size ? client->size : client->written,
+			     elapsed_us(&client->started));
 	list_del(&client->node);
 	close(client->sock);
-	close(client->fd);
-	free(client);
+	if (client->blocks) {
+		blockcache_put(client->blocks);
+		blockcache_cursor_release(&client->cursor);
+	} else {
+		translate_close(client->fd);
+	}
+	client_release(client);
 }
 
-int main(int argc, char **argv)
+/* Time until a window, or the answer to a request, is to be sent again */
+static long tftp_retransmit_remaining(struct list_head *clients, long timeout)
 {
 	struct tftp_client *client;
-	struct tftp_client *next;
-	struct sockaddr_qrtr sq;
-	struct qrtr_packet pkt;
-	socklen_t sl;
-	ssize_t len;
-	char buf[4096];
-	fd_set rfds;
-	int nfds;
-	int opcode;
-	int ret;
-	int fd;
+	long remaining;
 
-	fd = qrtr_open(0);
-	if (fd < 0) {
-		fprintf(stderr, "failed to open qrtr socket\n");
-		exit(1);
-	}
+	list_for_each_entry(client, clients, node) {
+		if (!client->awaiting_ack)
+			continue;
 
-	ret = qrtr_publish(fd, 4096, 1, 0);
-	if (ret < 0) {
-		fprintf(stderr, "failed to publish service registry service\n");
-		exit(1);
+		remaining = client->timeoutms - elapsed_ms(&client->sent);
+		if (remaining < 0)
+			remaining = 0;
+		if (timeout < 0 || remaining < timeout)
+			timeout = remaining;
 	}
 
-	zstd_init();
+	return timeout;
+}
 
-	for (;;) {
-		FD_ZERO(&rfds);
-		FD_SET(fd, &rfds);
-		nfds = fd;
+/* Time until a window is to be sent again, in ms, -1 if none is */
+static int tftp_retransmit_timeout(void)
+{
+	long timeout;
 
-		list_for_each_entry(client, &writers, node) {
-			FD_SET(client->sock, &rfds);
-			nfds = MAX(nfds, client->sock);
-		}
+	if (!config.retransmits)
+		return -1;
 
-		list_for_each_entry(client, &readers, node) {
-			FD_SET(client->sock, &rfds);
-			nfds = MAX(nfds, client->sock);
-		}
+	timeout = tftp_retransmit_remaining(&readers, -1);
 
-		ret = select(nfds + 1, &rfds, NULL, NULL, NULL);
-		if (ret < 0) {
-			if (errno == EINTR) {
-				continue;
-			} else {
-				fprintf(stderr, "select failed\n");
-				break;
-			}
+	return tftp_retransmit_remaining(&writers, timeout);
+}
+
+/* Whether @client went unanswered for too long, closing it past the limit */
+static bool tftp_retransmit_due(struct tftp_client *client)
+{
+	if (!client->awaiting_ack ||
+	    elapsed_ms(&client->sent) < client->timeoutms)
+		return false;
+
+	if (client->retries++ >= config.retransmits) {
+		pr_warn("%s not acknowledged, dropping transfer",
+			client->filename);
+		client_close_and_free(client);
+		return false;
+	}
+
+	metrics_add(METRICS_RETRANSMITS, 1);
+	TQFTP_PROBE3(retransmit, client->sq.sq_node, client->sq.sq_port,
+		     client->acked + 1);
+
+	return true;
+}
+
+/* Send windows not acknowledged within the timeout again, up to a limit */
+static void tftp_retransmit(void)
+{
+	struct tftp_client *client;
+	struct tftp_client *next;
+
+	if (!config.retransmits)
+		return;
+
+	list_for_each_entry_safe(client, next, &readers, node) {
+		if (!tftp_retransmit_due(client))
+			continue;
+
+		if (client->oack_pending) {
+			tftp_send_client_oack(client);
+			clock_gettime(CLOCK_MONOTONIC, &client->sent);
+		} else {
+			tftp_send_window(client, client->acked);
+		}
+	}
+
+	/* Writers until their first DATA, which the remote retransmits after */
+	list_for_each_entry_safe(client, next, &writers, node) {
+		if (!tftp_retransmit_due(client))
+			continue;
+
+		if (client->oack_pending)
+			tftp_send_client_oack(client);
+		else
+			tftp_send_ack(client->sock, 0);
+		clock_gettime(CLOCK_MONOTONIC, &client->sent);
+	}
+}
+
+/* Answer a request with "server busy", for the remote to ask again later */
+static void tftp_reject_busy(struct sockaddr_qrtr *sq)
+{
+	int sock;
+
+	sock = qrtr_open(0);
+	if (sock < 0)
+		return;
+
+	if (connect(sock, (struct sockaddr *)sq, sizeof(*sq)) == 0)
+		tftp_send_error(sock, 0, "server busy");
+	close(sock);
+}
+
+/* Reject a request that wasn't admitted in time */
+static void tftp_reject(struct sockaddr_qrtr *sq)
+{
+	pr_warn("node %u over its limits, reject", sq->sq_node);
+	tftp_reject_busy(sq);
+}
+
+static void tftp_handoff_client(int conn, struct tftp_client *client,
+				enum handoff_type type)
+{
+	struct handoff_item item = {
+		.version = HANDOFF_VERSION,
+		.type = type,
+		.node = client->sq.sq_node,
+		.port = client->sq.sq_port,
+		.tsize = client->tsize,
+		.blksize = client->blksize,
+		.rsize = client->rsize,
+		.wsize = client->wsize,
+		.timeoutms = client->timeoutms,
+		.seek = client->seek,
+		.size = client->size,
+		.started_sec = client->started.tv_sec,
+		.started_nsec = client->started.tv_nsec,
+		.charged = client->fd >= 0 ? client->charged : 0,
+		.acked = client->acked,
+		.sent_sec = client->sent.tv_sec,
+		.sent_nsec = client->sent.tv_nsec,
+		.awaiting_ack = client->awaiting_ack,
+		.oack_pending = client->oack_pending,
+		.written = client->written,
+		.synced = client->synced,
+		.no_writeback = client->no_writeback,
+	};
+	/* Readers of in-memory copies reopen the file by name */
+	int fds[HANDOFF_MAX_FDS] = { client->sock, client->blocks ? -1 : client->fd };
+
+	strncpy(item.filename, client->filename, sizeof(item.filename) - 1);
+
+	if (handoff_send(conn, &item, fds) < 0)
+		pr_err("failed to hand off transfer of %s", client->filename);
+}
+
+/**
+ * tftp_handoff() - hand off the service and all transfers, then exit
+ * @conn:	connection to the process taking over
+ * @fd:		published qrtr socket
+ * @pid:	pid of the process taking over
+ *
+ * Transfers only progress on ACKs from the remote, all of which have been
+ * responded to at this point; so the new process resumes each transfer at
+ * the remote's next ACK, or DATA for uploads, without loss. Handing off the
+ * published socket keeps the service registered throughout.
+ */
+static void tftp_handoff(int conn, int fd, pid_t pid)
+{
+	struct handoff_item item = {
+		.version = HANDOFF_VERSION,
+		.type = HANDOFF_SERVICE,
+	};
+	int fds[HANDOFF_MAX_FDS] = { fd, -1 };
+	struct tftp_client *client;
+	char state[32];
+
+	if (handoff_send(conn, &item, fds) < 0) {
+		pr_err("failed to hand off service, continuing");
+		close(conn);
+		return;
+	}
+
+	/* Before exiting, for the service manager not to restart the service */
+	snprintf(state, sizeof(state), "MAINPID=%d", pid);
+	sdnotify(state);
+
+	/* For the new process to listen in its place */
+	control_exit();
+
+	/* Waiting requests aren't handed off, the remotes are to ask again */
+	admission_flush(tftp_reject_busy);
+
+	list_for_each_entry(client, &readers, node)
+		tftp_handoff_client(conn, client, HANDOFF_READER);
+
+	list_for_each_entry(client, &writers, node)
+		tftp_handoff_client(conn, client, HANDOFF_WRITER);
+
+	/* Saved before closing, as the new process loads them once done */
+	translate_sync();
+	timeline_dump(TIMELINE_PATH);
+	heatmap_save();
+
+	pr_info("handed off to new process, exiting");
+	close(conn);
+	exit(0);
+}
+
+/**
+ * tftp_takeover() - take over the service and transfers of a running process
+ * @pid:	pid of the running process
+ *
+ * The transfers are queued, to be resumed by tftp_resume() once the rest of
+ * the process is set up.
+ *
+ * Return: published qrtr socket, -1 on error
+ */
+static int tftp_takeover(pid_t pid)
+{
+	struct handoff_item item;
+	struct tftp_client *client;
+	int fds[HANDOFF_MAX_FDS];
+	int conn;
+	int fd = -1;
+	int ret;
+
+	conn = handoff_connect(pid);
+	if (conn < 0) {
+		fprintf(stderr, "failed to connect to process %d\n", pid);
+		return -1;
+	}
+
+	while ((ret = handoff_recv(conn, &item, fds)) > 0) {
+		if (item.type == HANDOFF_SERVICE) {
+			fd = fds[0];
+			continue;
+		}
+
+		if (fds[0] < 0)
+			continue;
+
+		client = client_alloc(item.blksize);
+		if (!client) {
+			close(fds[0]);
+			if (fds[1] >= 0)
+				close(fds[1]);
+			continue;
+		}
+		client->sq.sq_family = AF_QIPCRTR;
+		client->sq.sq_node = item.node;
+		client->sq.sq_port = item.port;
+		client->sock = fds[0];
+		client->fd = fds[1];
+		client->filename = strdup(item.filename);
+		client->tsize = item.tsize;
+		client->blksize = item.blksize;
+		client->rsize = item.rsize;
+		client->wsize = item.wsize;
+		client->timeoutms = item.timeoutms;
+		client->seek = item.seek;
+		client->size = item.size;
+		client->started.tv_sec = item.started_sec;
+		client->started.tv_nsec = item.started_nsec;
+		client->charged = item.charged;
+		client->acked = item.acked;
+		/* CLOCK_MONOTONIC is shared, lost packets are sent again on time */
+		client->sent.tv_sec = item.sent_sec;
+		client->sent.tv_nsec = item.sent_nsec;
+		client->awaiting_ack = item.awaiting_ack;
+		client->oack_pending = item.oack_pending;
+		client->written = item.written;
+		client->synced = item.synced;
+		client->no_writeback = item.no_writeback;
+
+		list_add(item.type == HANDOFF_WRITER ? &writers : &readers,
+			 &client->node);
+	}
+	close(conn);
+
+	if (ret < 0 || fd < 0) {
+		fprintf(stderr, "failed to take over from process %d\n", pid);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* Reattach the transfers taken over by tftp_takeover() to their files */
+static void tftp_resume(void)
+{
+	struct tftp_client *client;
+	struct tftp_client *next;
+	unsigned int n = 0;
+
+	list_for_each_entry(client, &writers, node) {
+		translate_adopt(client->filename, client->fd);
+		admission_adopt(client->sq.sq_node, 0);
+		timeline_begin(&client->timeline, client->sq.sq_node,
+			       client->sq.sq_port, client->filename, true);
+		n++;
+	}
+
+	list_for_each_entry_safe(client, next, &readers, node) {
+		admission_adopt(client->sq.sq_node, client->charged);
+		timeline_begin(&client->timeline, client->sq.sq_node,
+			       client->sq.sq_port, client->filename, false);
+		client->heat = heatmap_lookup(client->filename);
+		n++;
+		if (client->fd >= 0)
+			continue;
+
+		if (cache_open(client->filename, &client->fd, &client->blocks) < 0)
+			client->fd = translate_open(client->filename, O_RDONLY);
+		if (client->blocks)
+			blockcache_cursor_init(client->blocks, &client->cursor);
+		if (client->fd < 0 && !client->blocks) {
+			pr_warn("unable to reopen %s, dropping transfer",
+				client->filename);
+			tftp_send_error(client->sock, 1, "file not found");
+			client_close_and_free(client);
+			n--;
+		}
+	}
+
+	pr_info("resumed %u transfers", n);
+}
+
+/* A remote node, taken as up while it has servers registered */
+struct tftp_remote {
+	struct list_head node;
+
+	unsigned int id;
+	unsigned int servers;
+};
+
+static struct list_head remotes = LIST_INIT(remotes);
+
+/* Set once the servers registered before the lookup have all been listed */
+static bool lookup_listed;
+static unsigned int local_node;
+
+static struct tftp_remote *tftp_remote_get(unsigned int id)
+{
+	struct tftp_remote *remote;
+
+	list_for_each_entry(remote, &remotes, node) {
+		if (remote->id == id)
+			return remote;
+	}
+
+	remote = calloc(1, sizeof(*remote));
+	if (!remote)
+		return NULL;
+
+	remote->id = id;
+	list_add(&remotes, &remote->node);
+
+	return remote;
+}
+
+/**
+ * tftp_lookup_open() - watch remotes come up, as they register services
+ *
+ * The name service doesn't forward HELLOs to local sockets, so remotes
+ * coming up are spotted by their first server being registered.
+ *
+ * Return: socket to pass to tftp_lookup_handle(), -1 on error
+ */
+static int tftp_lookup_open(void)
+{
+	struct sockaddr_qrtr sq;
+	socklen_t sl = sizeof(sq);
+	int sock;
+
+	sock = qrtr_open(0);
+	if (sock < 0)
+		return -1;
+
+	/* Service 0 matches all services */
+	if (getsockname(sock, (void *)&sq, &sl) < 0 ||
+	    qrtr_new_lookup(sock, 0, 0, 0) < 0) {
+		qrtr_close(sock);
+		return -1;
+	}
+	local_node = sq.sq_node;
+
+	return sock;
+}
+
+/* Handle a server notification, prefetching for remotes coming up */
+static void tftp_lookup_handle(int sock, bool use_uevents)
+{
+	struct tftp_remote *remote;
+	struct sockaddr_qrtr sq;
+	struct qrtr_packet pkt;
+	socklen_t sl = sizeof(sq);
+	char buf[64];
+	ssize_t len;
+
+	len = recvfrom(sock, buf, sizeof(buf), 0, (void *)&sq, &sl);
+	if (len < 0 || sq.sq_port != QRTR_PORT_CTRL ||
+	    qrtr_decode(&pkt, buf, len, &sq) < 0)
+		return;
+
+	switch (pkt.type) {
+	case QRTR_TYPE_NEW_SERVER:
+		/* An empty notification ends the listing of existing servers */
+		if (!pkt.service && !pkt.port) {
+			lookup_listed = true;
+			break;
+		}
+
+		if (pkt.node == local_node)
+			break;
+
+		remote = tftp_remote_get(pkt.node);
+		if (!remote || remote->servers++)
+			break;
+
+		/* Remotes listed first were up before, and prefetched on startup */
+		if (!lookup_listed)
+			break;
+
+		pr_info("node %u came up", pkt.node);
+		bootprofile_prefetch(pkt.node);
+		if (use_uevents)
+			remoteproc_index_all();
+		break;
+	case QRTR_TYPE_DEL_SERVER:
+		list_for_each_entry(remote, &remotes, node) {
+			if (remote->id == pkt.node && remote->servers) {
+				remote->servers--;
+				break;
+			}
+		}
+		break;
+	}
+}
+
+/* Return: 0 on success, -1 if the request is to be ignored */
+static int tftp_parse(const char *buf, size_t len, struct tftp_request *req)
+{
+	const char *filename;
+	const char *mode;
+	const char *p;
+
+	memset(req, 0, offsetof(struct tftp_request, filename));
+	req->opcode = buf[0] << 8 | buf[1];
+	req->tsize = -1;
+	/* Without an OACK the remote expects 512 byte blocks, one at a time */
+	req->blksize = 512;
+	req->timeoutms = config.timeoutms;
+
+	filename = buf + 2;
+	mode = filename + strnlen(filename, len - 2) + 1;
+	if (mode >= buf + len)
+		return -1;
+	p = mode + strnlen(mode, buf + len - mode) + 1;
+	if (p > buf + len)
+		return -1;
+
+	if (strcasecmp(mode, "octet")) {
+		/* XXX: error */
+		pr_warn("not octet, reject");
+		return -1;
+	}
+
+	if (strlen(filename) >= sizeof(req->filename)) {
+		pr_warn("file name too long, reject");
+		return -1;
+	}
+	strcpy(req->filename, filename);
+
+	if (p < buf + len) {
+		/* Configured values are offered in the OACK, unless negotiated */
+		req->do_oack = true;
+		req->blksize = config.blksize;
+		req->wsize = config.wsize;
+		parse_options(p, len - (p - buf), &req->blksize, &req->tsize,
+			      &req->wsize, &req->timeoutms, &req->rsize, &req->seek);
+	}
+
+	return 0;
+}
+
+/* Start the transfer of a parsed request, as retried by admission_tick() */
+static int tftp_start(const void *data, size_t len, struct sockaddr_qrtr *sq)
+{
+	const struct tftp_request *req = data;
+
+	return req->opcode == OP_RRQ ? handle_rrq(req, sq) : handle_wrq(req, sq);
+}
+
+/*
+ * Handle a request received from a remote. Requests not admitted yet are
+ * queued as parsed, so that retrying them only repeats the admission.
+ */
+static void tftp_request(const char *buf, size_t len, struct sockaddr_qrtr *sq)
+{
+	struct tftp_request req;
+	bool write;
+
+	if (tftp_parse(buf, len, &req) < 0)
+		return;
+
+	write = req.opcode == OP_WRQ;
+	if (write) {
+		metrics_add(METRICS_WRQ, 1);
+		TQFTP_PROBE3(wrq, sq->sq_node, sq->sq_port, req.filename);
+		pr_info("WRQ: %s", req.filename);
+	} else {
+		metrics_add(METRICS_RRQ, 1);
+		TQFTP_PROBE3(rrq, sq->sq_node, sq->sq_port, req.filename);
+		pr_info("RRQ: %s (rsize=%zu seek=%lld)", req.filename, req.rsize,
+			(long long)req.seek);
+	}
+	timeline_begin(&req.timeline, sq->sq_node, sq->sq_port, req.filename, write);
+
+	if (tftp_start(&req, sizeof(req), sq) != -EAGAIN)
+		return;
+
+	if (admission_defer(&req, offsetof(struct tftp_request, filename) +
+			    strlen(req.filename) + 1, sq) < 0)
+		tftp_reject(sq);
+}
+
+/* Clamp the tunables to what's supported, and apply those held elsewhere */
+static void tftp_config_apply(void)
+{
+	if (!config.max_blksize || config.max_blksize > TQFTP_MAX_BLKSIZE)
+		config.max_blksize = TQFTP_MAX_BLKSIZE;
+	if (TQFTP_MAX_WSIZE &&
+	    (!config.max_wsize || config.max_wsize > TQFTP_MAX_WSIZE))
+		config.max_wsize = TQFTP_MAX_WSIZE;
+
+	if (config.blksize > config.max_blksize)
+		config.blksize = config.max_blksize;
+	if (config.max_wsize && config.wsize > config.max_wsize)
+		config.wsize = config.max_wsize;
+
+	if (translate_set_roots(config.firmware_root, config.readwrite_root) < 0)
+		pr_err("failed to set firmware or readwrite root");
+
+	logger_set_level(config.log_level);
+}
+
+/* Apply the configuration, after it changed from @old */
+static void tftp_config_changed(const struct tqftp_config *old)
+{
+	tftp_config_apply();
+
+	/* Cached files were resolved against the old firmware root */
+	if (strcmp(config.firmware_root, old->firmware_root))
+		cache_flush();
+
+	if (config.cache_size >= 0 && config.cache_size != old->cache_size)
+		cache_resize(config.cache_size);
+
+	if (config.predict_size != old->predict_size &&
+	    predict_init(config.predict_size) < 0)
+		pr_err("failed to start predictive prefetching");
+}
+
+/**
+ * tftp_reload() - reload the config file, keeping transfers going
+ * @path:	config file
+ * @base:	configuration from the command line, the file applies on top
+ *
+ * New requests use the new values, transfers already going keep the ones
+ * they negotiated. An invalid file leaves the current configuration in place.
+ */
+static void tftp_reload(const char *path, const struct tqftp_config *base)
+{
+	struct tqftp_config new = *base;
+	struct tqftp_config old = config;
+
+	if (config_load(path, &new) < 0 && errno != ENOENT) {
+		pr_err("failed to reload %s, keeping configuration", path);
+		return;
+	}
+
+	config = new;
+	tftp_config_changed(&old);
+
+	pr_info("reloaded %s", path);
+}
+
+static void tftp_control_list(FILE *out)
+{
+	struct tftp_client *client;
+	unsigned long long done;
+	long elapsed;
+
+	fprintf(out, "type node port file done size rate\n");
+
+	list_for_each_entry(client, &readers, node) {
+		done = (unsigned long long)client->acked * client->blksize;
+		if (client->rsize && done > client->rsize)
+			done = client->rsize;
+		elapsed = elapsed_ms(&client->started);
+		fprintf(out, "read %u %u %s %llu %zu %llu\n",
+			client->sq.sq_node, client->sq.sq_port, client->filename,
+			client->seek + done,
+			client->rsize && client->seek + client->rsize < client->size ?
+			client->seek + client->rsize : client->size,
+			elapsed > 0 ? done * 1000 / elapsed : 0);
+	}
+
+	list_for_each_entry(client, &writers, node) {
+		elapsed = elapsed_ms(&client->started);
+		fprintf(out, "write %u %u %s %llu - %llu\n",
+			client->sq.sq_node, client->sq.sq_port, client->filename,
+			(unsigned long long)client->written,
+			elapsed > 0 ? client->written * 1000ULL / elapsed : 0);
+	}
+}
+
+static int tftp_control_cancel(unsigned int node, unsigned int port)
+{
+	struct tftp_client *client;
+	struct tftp_client *next;
+	int ret = -1;
+
+	list_for_each_entry_safe(client, next, &readers, node) {
+		if (client->sq.sq_node == node && client->sq.sq_port == port) {
+			tftp_send_error(client->sock, 0, "cancelled");
+			client_close_and_free(client);
+			ret = 0;
+		}
+	}
+
+	list_for_each_entry_safe(client, next, &writers, node) {
+		if (client->sq.sq_node == node && client->sq.sq_port == port) {
+			tftp_send_error(client->sock, 0, "cancelled");
+			client_close_and_free(client);
+			ret = 0;
 		}
+	}
+
+	return ret;
+}
+
+/* Pin a file, resolving it into the cache first if needed */
+/*
+ * Files not cached yet are resolved by the prefetch thread, as that may take
+ * a whole decompression, and pinned once it cached them.
+ */
+static int tftp_control_pin(const char *path)
+{
+	if (!cache_pin(path, true))
+		return 0;
+
+	if (!cache_capacity() || prefetch_init() < 0)
+		return -1;
+
+	return prefetch_pin(path);
+}
+
+/*
+ * Commands of the control socket. Tunables changed by "set" apply until the
+ * config file is reloaded.
+ */
+static void tftp_control(char *line, FILE *out)
+{
+	struct tqftp_config old = config;
+	unsigned int node;
+	unsigned int port;
+	char *save = NULL;
+	char *cmd;
+	char *arg;
+	char *value;
+	int n;
+
+	cmd = strtok_r(line, " \t", &save);
+	arg = strtok_r(NULL, " \t", &save);
+	value = strtok_r(NULL, "", &save);
+
+	if (!cmd) {
+		return;
+	} else if (!strcmp(cmd, "list")) {
+		tftp_control_list(out);
+	} else if (!strcmp(cmd, "cancel")) {
+		if (!arg || sscanf(arg, "%u:%u", &node, &port) != 2 ||
+		    tftp_control_cancel(node, port) < 0)
+			fprintf(out, "error: no transfer <node>:<port>\n");
+	} else if (!strcmp(cmd, "cache")) {
+		if (!arg)
+			cache_dump(out);
+		else if (!strcmp(arg, "flush"))
+			cache_flush();
+		else
+			fprintf(out, "error: unknown cache command\n");
+	} else if (!strcmp(cmd, "pin")) {
+		if (!arg || tftp_control_pin(arg) < 0)
+			fprintf(out, "error: unable to cache file\n");
+	} else if (!strcmp(cmd, "unpin")) {
+		if (!arg || cache_pin(arg, false) < 0)
+			fprintf(out, "error: file not cached\n");
+	} else if (!strcmp(cmd, "set")) {
+		if (!arg || !value || config_set(&config, arg, value) < 0)
+			fprintf(out, "error: invalid setting\n");
+		else
+			tftp_config_changed(&old);
+	} else if (!strcmp(cmd, "timeline")) {
+		n = timeline_dump(TIMELINE_PATH);
+		if (n < 0)
+			fprintf(out, "error: unable to write %s\n", TIMELINE_PATH);
+		else
+			fprintf(out, "%d transfers written to %s\n", n, TIMELINE_PATH);
+	} else if (!strcmp(cmd, "profile")) {
+		profiler_dump(out);
+	} else if (!strcmp(cmd, "heatmap")) {
+		heatmap_dump(out);
+	} else {
+		fprintf(out, "commands:\n"
+			"  list                  list transfers\n"
+			"  cancel <node>:<port>  cancel a transfer\n"
+			"  cache [flush]         list, or drop, cached files\n"
+			"  pin <path>            cache a file in the background, keep it cached\n"
+			"  unpin <path>          let a file be evicted again\n"
+			"  set <key> <value>     change a tunable of the config file\n"
+			"  timeline              write timelines of recent transfers\n"
+			"  profile               CPU cycles of transfers, per file and node\n"
+			"  heatmap               requests and ranges read, per file\n");
+	}
+}
+
+static void tftp_sighup(int signo)
+{
+	reload_requested = 1;
+}
+
+static void tftp_sigusr1(int signo)
+{
+	profile_requested = 1;
+}
+
+static void tftp_sigterm(int signo)
+{
+	terminate_requested = 1;
+}
+
+static void usage(const char *progname)
+{
+	fprintf(stderr, "usage: %s [-a <n>] [-A <n>] [-b] [-c <MiB>] [-C <cpus>] [-D <MiB>]\n"
+		"       [-f <file>] [-H] [-l] [-p] [-P <MiB>] [-r] [-R <prio>] [-s <MiB>] [-S]\n"
+		"       [-t] [-u] [-U <pid>] [-w <ms>] [-z]\n", progname);
+	fprintf(stderr, "  -a  transfers allowed at once per remote node\n");
+	fprintf(stderr, "  -A  requests admitted per second per remote node\n");
+	fprintf(stderr, "  -b  keep cached decompressed files compressed in memory\n");
+	fprintf(stderr, "  -c  size of the cache of resolved files\n");
+	fprintf(stderr, "  -C  run on these CPUs, such as 0,2-3, implies -r\n");
+	fprintf(stderr, "  -D  decompressed copies held by transfers, at most\n");
+	fprintf(stderr, "  -f  config file, reloaded on SIGHUP (default " CONFIG_PATH ")\n");
+	fprintf(stderr, "  -H  back large decompressed files by transparent huge pages\n");
+	fprintf(stderr, "  -l  store /readwrite files in a log-structured store\n");
+	fprintf(stderr, "  -p  record boot sequences of remotes and prefetch them\n");
+	fprintf(stderr, "  -P  prefetch up to this much of the files likely requested next\n");
+	fprintf(stderr, "  -r  real-time mode: lock memory, preallocate and track packet latency;\n"
+		"      at most %d times -a transfers at once, %d without -a\n",
+		RT_POOL_NODES, RT_POOL_CLIENTS);
+	fprintf(stderr, "  -R  run at this SCHED_FIFO priority, implies -r\n");
+	fprintf(stderr, "  -s  share decompressed files with other instances, in a region this large\n");
+	fprintf(stderr, "  -S  profile the CPU cycles, or time, of transfers, printed on SIGUSR1\n");
+	fprintf(stderr, "  -t  report the time taken to publish the service and respond\n");
+	fprintf(stderr, "  -u  prefetch firmware directories of remoteprocs as they start\n");
+	fprintf(stderr, "  -U  take over the service and transfers of a running instance\n");
+	fprintf(stderr, "  -w  wait up to this long for admission, instead of rejecting\n");
+	fprintf(stderr, "  -z  compress cold /readwrite files in the background\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct admission_limits limits = {};
+	struct tftp_client *client;
+	struct tftp_client *next;
+	struct sockaddr_qrtr sq;
+	struct qrtr_packet pkt;
+	socklen_t sl;
+	ssize_t len;
+	char buf[4096];
+	struct timeval tv;
+	fd_set rfds;
+	fd_set wfds;
+	fd_set efds;
+	int timeout;
+	int nfds;
+	const char *config_path = CONFIG_PATH;
+	bool config_required = false;
+	struct tqftp_config config_base;
+	ssize_t cache_size;
+	size_t predict_size;
+	size_t shm_size = 0;
+	bool use_bootprofile = false;
+	bool use_blockcache = false;
+	bool use_uevents = false;
+	bool use_logstore = false;
+	bool use_compression = false;
+	pid_t takeover_pid = 0;
+	char state[32];
+	pid_t pid;
+	const char *rt_cpus = NULL;
+	bool use_rt = false;
+	int rt_priority = 0;
+	int handoff_fd;
+	int conn;
+	int uevent_fd = -1;
+	int lookup_fd = -1;
+	int psi_fd = -1;
+	int shm_fd = -1;
+	int opcode;
+	int opt;
+	int ret;
+	int fd = -1;
+
+	while ((opt = getopt(argc, argv, "a:A:bc:C:D:f:HlpP:rR:s:StuU:w:z")) != -1) {
+		switch (opt) {
+		case 'a':
+			limits.sessions = strtoul(optarg, NULL, 10);
+			break;
+		case 'A':
+			limits.rate = strtoul(optarg, NULL, 10);
+			break;
+		case 'b':
+			use_blockcache = true;
+			break;
+		case 'c':
+			config.cache_size = strtoul(optarg, NULL, 10) * 1024 * 1024;
+			break;
+		case 'C':
+			rt_cpus = optarg;
+			use_rt = true;
+			break;
+		case 'D':
+			limits.decompressed = strtoul(optarg, NULL, 10) * 1024 * 1024;
+			break;
+		case 'f':
+			config_path = optarg;
+			config_required = true;
+			break;
+		case 'H':
+			zstd_use_hugepages();
+			break;
+		case 'l':
+			use_logstore = true;
+			break;
+		case 'p':
+			use_bootprofile = true;
+			break;
+		case 'P':
+			config.predict_size = strtoul(optarg, NULL, 10) * 1024 * 1024;
+			break;
+		case 'r':
+			use_rt = true;
+			break;
+		case 'R':
+			rt_priority = atoi(optarg);
+			use_rt = true;
+			break;
+		case 's':
+			shm_size = strtoul(optarg, NULL, 10) * 1024 * 1024;
+			break;
+		case 'S':
+			profiler_enable();
+			break;
+		case 't':
+			startup_timing_enable();
+			break;
+		case 'u':
+			use_uevents = true;
+			break;
+		case 'U':
+			takeover_pid = strtoul(optarg, NULL, 10);
+			break;
+		case 'w':
+			limits.wait = strtoul(optarg, NULL, 10);
+			break;
+		case 'z':
+			use_compression = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	admission_init(&limits);
+
+	/* Reloading starts over from the command line, then the config file */
+	config_base = config;
+	if (config_load(config_path, &config) < 0 &&
+	    (config_required || errno != ENOENT)) {
+		fprintf(stderr, "failed to load %s\n", config_path);
+		exit(1);
+	}
+	tftp_config_apply();
+	cache_size = config.cache_size;
+	predict_size = config.predict_size;
+	signal(SIGHUP, tftp_sighup);
+	signal(SIGUSR1, tftp_sigusr1);
+	signal(SIGTERM, tftp_sigterm);
+	signal(SIGINT, tftp_sigterm);
+
+	/* Before real-time mode, for the drain thread not to compete with it */
+	if (logger_init() < 0)
+		fprintf(stderr, "failed to start logging thread, logging synchronously\n");
+
+	if (writeback_init() < 0)
+		fprintf(stderr, "failed to start writeback thread, leaving uploads to the kernel\n");
+
+#if TQFTP_MAX_CLIENTS
+	client_slots_init();
+#endif
+
+	/*
+	 * Take over before opening the /readwrite store, so that it's loaded
+	 * after the running instance made its last change to it.
+	 */
+	if (takeover_pid) {
+		fd = tftp_takeover(takeover_pid);
+		if (fd < 0)
+			exit(1);
+	}
+
+	if (!takeover_pid) {
+		fd = qrtr_open(0);
+		if (fd < 0) {
+			fprintf(stderr, "failed to open qrtr socket\n");
+			exit(1);
+		}
+
+		ret = qrtr_publish(fd, 4096, 1, 0);
+		if (ret < 0) {
+			fprintf(stderr, "failed to publish service registry service\n");
+			exit(1);
+		}
+
+		/*
+		 * Everything below is deferred until after publication, requests
+		 * arriving meanwhile are queued on the socket.
+		 */
+		sdnotify("READY=1");
+		startup_published();
+	}
+
+	metrics_init();
+	heatmap_init();
+
+	if (use_logstore && translate_use_logstore() < 0) {
+		fprintf(stderr, "failed to initialize log-structured store\n");
+		exit(1);
+	}
+
+	if (use_compression && translate_compress_readwrite() < 0) {
+		fprintf(stderr, "failed to start compression at rest\n");
+		exit(1);
+	}
+
+	if (cache_size < 0)
+		cache_size = use_bootprofile || predict_size || use_uevents || shm_size ?
+			     DEFAULT_CACHE_SIZE : 0;
+	cache_init(cache_size, use_blockcache);
+	if (cache_size)
+		psi_fd = membudget_init();
+	if (shm_size)
+		shm_fd = shmcache_init(shm_size);
+	if (cache_size)
+		fdstore_init();
+
+	if (use_bootprofile && bootprofile_init() < 0) {
+		fprintf(stderr, "failed to start boot profile prefetching\n");
+		exit(1);
+	}
+
+	if (predict_size && predict_init(predict_size) < 0) {
+		fprintf(stderr, "failed to start predictive prefetching\n");
+		exit(1);
+	}
+
+	if (use_uevents) {
+		if (prefetch_init() < 0) {
+			fprintf(stderr, "failed to start prefetching\n");
+			exit(1);
+		}
+
+		uevent_fd = remoteproc_uevent_open();
+		remoteproc_index_all();
+	}
+
+	if (use_bootprofile || use_uevents) {
+		lookup_fd = tftp_lookup_open();
+		if (lookup_fd < 0)
+			fprintf(stderr, "failed to watch for remotes coming up\n");
+	}
+
+	if (takeover_pid) {
+		tftp_resume();
+
+		/* The previous process made this one the main process as well */
+		snprintf(state, sizeof(state), "MAINPID=%d\nREADY=1", getpid());
+		sdnotify(state);
+	}
+
+	/* After any takeover, the previous process stopped listening by then */
+	control_init(tftp_control);
+
+	/* Last, so that everything set up above is locked in memory */
+	if (use_rt) {
+		if (rt_init(rt_priority, rt_cpus) < 0) {
+			fprintf(stderr, "failed to enter real-time mode\n");
+			exit(1);
+		}
+		/* Enough for every transfer admission would let through */
+		if (!TQFTP_MAX_CLIENTS &&
+		    client_pool_fill(limits.sessions ?
+				     limits.sessions * RT_POOL_NODES :
+				     RT_POOL_CLIENTS) < 0) {
+			fprintf(stderr, "failed to preallocate clients\n");
+			exit(1);
+		}
+	}
+
+	handoff_fd = handoff_listen();
+
+	for (;;) {
+		if (terminate_requested)
+			break;
+
+		if (reload_requested) {
+			reload_requested = 0;
+			tftp_reload(config_path, &config_base);
+		}
+
+		if (profile_requested) {
+			profile_requested = 0;
+			profiler_dump(stdout);
+			fflush(stdout);
+		}
+
+		FD_ZERO(&rfds);
+		FD_ZERO(&wfds);
+		FD_ZERO(&efds);
+		FD_SET(fd, &rfds);
+		nfds = fd;
+
+		/* Memory pressure events are signalled as exceptional conditions */
+		if (psi_fd >= 0) {
+			FD_SET(psi_fd, &efds);
+			nfds = MAX(nfds, psi_fd);
+		}
+
+		if (uevent_fd >= 0) {
+			FD_SET(uevent_fd, &rfds);
+			nfds = MAX(nfds, uevent_fd);
+		}
+
+		if (lookup_fd >= 0) {
+			FD_SET(lookup_fd, &rfds);
+			nfds = MAX(nfds, lookup_fd);
+		}
+
+		if (shm_fd >= 0) {
+			FD_SET(shm_fd, &rfds);
+			nfds = MAX(nfds, shm_fd);
+		}
+
+		if (handoff_fd >= 0) {
+			FD_SET(handoff_fd, &rfds);
+			nfds = MAX(nfds, handoff_fd);
+		}
+
+		list_for_each_entry(client, &writers, node) {
+			FD_SET(client->sock, &rfds);
+			nfds = MAX(nfds, client->sock);
+		}
+
+		list_for_each_entry(client, &readers, node) {
+			FD_SET(client->sock, &rfds);
+			nfds = MAX(nfds, client->sock);
+		}
+
+		timeout = membudget_timeout();
+		ret = admission_timeout();
+		if (ret >= 0 && (timeout < 0 || ret < timeout))
+			timeout = ret;
+		ret = tftp_retransmit_timeout();
+		if (ret >= 0 && (timeout < 0 || ret < timeout))
+			timeout = ret;
+		ret = metrics_timeout();
+		if (ret >= 0 && (timeout < 0 || ret < timeout))
+			timeout = ret;
+		ret = heatmap_timeout();
+		if (ret >= 0 && (timeout < 0 || ret < timeout))
+			timeout = ret;
+		tv.tv_sec = timeout / 1000;
+		tv.tv_usec = (timeout % 1000) * 1000;
+
+		control_fds(&rfds, &wfds, &nfds);
+
+		ret = select(nfds + 1, &rfds, &wfds, &efds, timeout >= 0 ? &tv : NULL);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			} else {
+				fprintf(stderr, "select failed\n");
+				break;
+			}
+		}
+
+		if (psi_fd >= 0 && FD_ISSET(psi_fd, &efds))
+			membudget_handle();
+		membudget_tick();
+		admission_tick(tftp_start, tftp_reject);
+		tftp_retransmit();
+		metrics_tick();
+		heatmap_tick();
 
 		list_for_each_entry_safe(client, next, &writers, node) {
 			if (FD_ISSET(client->sock, &rfds)) {
+				rt_packet_start();
 				ret = handle_writer(client);
+				rt_packet_end();
 				if (ret <= 0)
 					client_close_and_free(client);
 			}
@@ -608,19 +2104,38 @@ int main(int argc, char **argv)
 
 		list_for_each_entry_safe(client, next, &readers, node) {
 			if (FD_ISSET(client->sock, &rfds)) {
+				rt_packet_start();
 				ret = handle_reader(client);
+				rt_packet_end();
 				if (ret <= 0)
 					client_close_and_free(client);
 			}
 		}
 
+		if (uevent_fd >= 0 && FD_ISSET(uevent_fd, &rfds))
+			remoteproc_uevent_handle(uevent_fd);
+
+		if (lookup_fd >= 0 && FD_ISSET(lookup_fd, &rfds))
+			tftp_lookup_handle(lookup_fd, use_uevents);
+
+		if (shm_fd >= 0 && FD_ISSET(shm_fd, &rfds))
+			shmcache_handle(shm_fd);
+
+		control_handle(&rfds, &wfds);
+
+		if (handoff_fd >= 0 && FD_ISSET(handoff_fd, &rfds)) {
+			conn = handoff_accept(handoff_fd, &pid);
+			if (conn >= 0)
+				tftp_handoff(conn, fd, pid);
+		}
+
 		if (FD_ISSET(fd, &rfds)) {
 			sl = sizeof(sq);
 			len = recvfrom(fd, buf, sizeof(buf), 0, (void *)&sq, &sl);
 			if (len < 0) {
 				ret = -errno;
 				if (ret != -ENETRESET)
-					fprintf(stderr, "[TQFTP] recvfrom failed: %d\n", ret);
+					pr_err("recvfrom failed: %d", ret);
 				return ret;
 			}
 
@@ -628,13 +2143,15 @@ int main(int argc, char **argv)
 			if (sq.sq_port == QRTR_PORT_CTRL) {
 				ret = qrtr_decode(&pkt, buf, len, &sq);
 				if (ret < 0) {
-					fprintf(stderr, "[TQFTP] unable to decode qrtr packet\n");
+					pr_err("unable to decode qrtr packet");
 					return ret;
 				}
 
 				switch (pkt.type) {
 				case QRTR_TYPE_BYE:
 					// fprintf(stderr, "[TQFTP] got bye\n");
+					bootprofile_reset(sq.sq_node);
+					predict_reset(sq.sq_node);
 					list_for_each_entry_safe(client, next, &writers, node) {
 						if (client->sq.sq_node == sq.sq_node)
 							client_close_and_free(client);
@@ -655,18 +2172,15 @@ int main(int argc, char **argv)
 				opcode = buf[0] << 8 | buf[1];
 				switch (opcode) {
 				case OP_RRQ:
-					handle_rrq(buf, len, &sq);
-					break;
 				case OP_WRQ:
-					// printf("[TQFTP] write\n");
-					handle_wrq(buf, len, &sq);
+					tftp_request(buf, len, &sq);
 					break;
 				case OP_ERROR:
 					buf[len] = '\0';
-					printf("[TQFTP] received error: %d - %s\n", buf[2] << 8 | buf[3], buf + 4);
+					pr_warn("received error: %d - %s", buf[2] << 8 | buf[3], buf + 4);
 					break;
 				default:
-					printf("[TQFTP] unhandled op %d\n", opcode);
+					pr_warn("unhandled op %d", opcode);
 					break;
 				}
 			}
@@ -676,5 +2190,11 @@ int main(int argc, char **argv)
 	close(fd);
 	zstd_free();
 
+	if (use_rt)
+		rt_dump(stdout);
+
+	timeline_dump(TIMELINE_PATH);
+	heatmap_save();
+
 	return 0;
 }
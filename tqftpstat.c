@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <err.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+struct snapshot {
+	/* CLOCK_MONOTONIC, in ns, of the copy and of the server's last update */
+	uint64_t taken;
+	uint64_t updated;
+	uint64_t counters[METRICS_NR_COUNTERS];
+	uint64_t histograms[METRICS_NR_HISTOGRAMS][METRICS_BUCKETS];
+};
+
+static const struct metrics_page *metrics_map(const char *path)
+{
+	const struct metrics_page *page;
+	struct stat sb;
+	void *ptr;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		err(1, "failed to open %s", path);
+
+	if (fstat(fd, &sb) < 0)
+		err(1, "failed to stat %s", path);
+	if (sb.st_size < sizeof(*page))
+		errx(1, "%s is too small", path);
+
+	ptr = mmap(NULL, sizeof(*page), PROT_READ, MAP_SHARED, fd, 0);
+	if (ptr == MAP_FAILED)
+		err(1, "failed to map %s", path);
+	close(fd);
+
+	page = ptr;
+	if (page->magic != METRICS_MAGIC)
+		errx(1, "%s is not a metrics file", path);
+	if (page->version != METRICS_VERSION ||
+	    page->ncounters != METRICS_NR_COUNTERS ||
+	    page->nhistograms != METRICS_NR_HISTOGRAMS ||
+	    page->nbuckets != METRICS_BUCKETS)
+		errx(1, "%s is of an unsupported version %u", path, page->version);
+
+	return page;
+}
+
+/* Copy the metrics, retrying until no update happened meanwhile */
+static void metrics_read(const struct metrics_page *page, struct snapshot *snap)
+{
+	struct metrics_page *p = (struct metrics_page *)page;
+	struct timespec ts;
+	uint32_t seq;
+	int i;
+	int j;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	snap->taken = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+	for (;;) {
+		seq = atomic_load_explicit(&p->seq, memory_order_acquire);
+		if (seq & 1) {
+			usleep(1000);
+			continue;
+		}
+
+		snap->updated = atomic_load_explicit(&p->updated, memory_order_relaxed);
+		for (i = 0; i < METRICS_NR_COUNTERS; i++)
+			snap->counters[i] = atomic_load_explicit(&p->counters[i],
+								 memory_order_relaxed);
+		for (i = 0; i < METRICS_NR_HISTOGRAMS; i++) {
+			for (j = 0; j < METRICS_BUCKETS; j++)
+				snap->histograms[i][j] =
+					atomic_load_explicit(&p->histograms[i][j],
+							     memory_order_relaxed);
+		}
+
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(&p->seq, memory_order_relaxed) == seq)
+			return;
+	}
+}
+
+/* Upper bound, in us, of the bucket holding the @pct percentile */
+static uint64_t percentile(const uint64_t *buckets, uint64_t count, int pct)
+{
+	uint64_t target = (count * pct + 99) / 100;
+	uint64_t sum = 0;
+	int i;
+
+	for (i = 0; i < METRICS_BUCKETS; i++) {
+		sum += buckets[i];
+		if (sum >= target)
+			break;
+	}
+
+	return 1ULL << (i < METRICS_BUCKETS ? i : METRICS_BUCKETS - 1);
+}
+
+/* Print @now, less @prev if given, with rates over @secs seconds */
+static void print_metrics(const struct metrics_page *page,
+			  const struct snapshot *now, const struct snapshot *prev,
+			  double secs)
+{
+	uint64_t buckets[METRICS_BUCKETS];
+	uint64_t blocks;
+	uint64_t count;
+	uint64_t delta;
+	int i;
+	int j;
+
+	printf("%-20s %14s %12s\n", "counter", "total", "per second");
+	for (i = 0; i < METRICS_NR_COUNTERS; i++) {
+		delta = now->counters[i] - (prev ? prev->counters[i] : 0);
+		printf("%-20s %14llu %12.1f\n", page->counter_names[i],
+		       (unsigned long long)now->counters[i],
+		       secs > 0 ? delta / secs : 0.0);
+	}
+
+	blocks = now->counters[METRICS_BLOCKS_SENT] +
+		 now->counters[METRICS_BLOCKS_RECEIVED];
+	if (blocks)
+		printf("%-20s %14.2f\n", "syscalls-per-block",
+		       (double)now->counters[METRICS_SYSCALLS] / blocks);
+
+	count = now->counters[METRICS_CACHE_HITS] +
+		now->counters[METRICS_CACHE_MISSES];
+	if (count)
+		printf("%-20s %13.1f%%\n", "cache-hit-ratio",
+		       100.0 * now->counters[METRICS_CACHE_HITS] / count);
+
+	printf("\n%-20s %10s %10s %10s %10s\n",
+	       "histogram", "count", "p50", "p90", "p99");
+	for (i = 0; i < METRICS_NR_HISTOGRAMS; i++) {
+		count = 0;
+		for (j = 0; j < METRICS_BUCKETS; j++) {
+			buckets[j] = now->histograms[i][j] -
+				     (prev ? prev->histograms[i][j] : 0);
+			count += buckets[j];
+		}
+
+		if (!count) {
+			printf("%-20s %10d %10s %10s %10s\n",
+			       page->histogram_names[i], 0, "-", "-", "-");
+			continue;
+		}
+
+		printf("%-20s %10llu %10llu %10llu %10llu\n",
+		       page->histogram_names[i], (unsigned long long)count,
+		       (unsigned long long)percentile(buckets, count, 50),
+		       (unsigned long long)percentile(buckets, count, 90),
+		       (unsigned long long)percentile(buckets, count, 99));
+	}
+}
+
+static void usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [-i <interval>] [<metrics file>]\n", progname);
+	fprintf(stderr, "Prints the metrics of tqftpserv, since it started or,\n"
+			"with -i, over each interval of that many seconds\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const struct metrics_page *page;
+	const char *path = METRICS_PATH;
+	struct snapshot prev;
+	struct snapshot now;
+	uint64_t started;
+	int interval = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "i:")) != -1) {
+		switch (opt) {
+		case 'i':
+			interval = atoi(optarg);
+			if (interval <= 0)
+				usage(argv[0]);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind < argc)
+		path = argv[optind++];
+	if (optind < argc)
+		usage(argv[0]);
+
+	page = metrics_map(path);
+	metrics_read(page, &now);
+
+	if (!interval) {
+		started = atomic_load_explicit(&((struct metrics_page *)page)->started,
+					       memory_order_relaxed);
+		print_metrics(page, &now, NULL, (now.updated - started) / 1e9);
+		return 0;
+	}
+
+	for (;;) {
+		prev = now;
+		sleep(interval);
+		metrics_read(page, &now);
+
+		print_metrics(page, &now, &prev, (now.taken - prev.taken) / 1e9);
+		printf("\n");
+		fflush(stdout);
+	}
+
+	return 0;
+}
@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "timeline.h"
+
+/* Named after the phase that ends them */
+static const char * const span_names[TIMELINE_NR_PHASES] = {
+	[TIMELINE_REQUEST] = "request",
+	[TIMELINE_RESOLVED] = "resolve",
+	[TIMELINE_DECOMPRESSED] = "decompress",
+	[TIMELINE_CONNECTED] = "connect",
+	[TIMELINE_FIRST_SENT] = "first send",
+	[TIMELINE_CLOSED] = "close",
+};
+
+struct point {
+	uint64_t time;
+	const char *name;
+	unsigned int ack;
+};
+
+static bool first_event = true;
+
+static void print_string(FILE *out, const char *s)
+{
+	fputc('"', out);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fprintf(out, "\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			fprintf(out, "\\u%04x", *s);
+		else
+			fputc(*s, out);
+	}
+	fputc('"', out);
+}
+
+/* Print a complete event, times in ns from the start of the trace */
+static void print_event(FILE *out, const struct timeline *tl, const char *name,
+			unsigned int ack, uint64_t start, uint64_t end)
+{
+	fprintf(out, "%s\n{\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":",
+		first_event ? "" : ",", tl->node, tl->port, start / 1e3,
+		(end - start) / 1e3);
+	first_event = false;
+
+	if (ack) {
+		fprintf(out, "\"window %u\"", ack);
+	} else if (name) {
+		print_string(out, name);
+	} else {
+		/* The whole transfer */
+		print_string(out, tl->filename);
+		fprintf(out, ",\"args\":{\"op\":\"%s\",\"acks\":%u}",
+			tl->write ? "WRQ" : "RRQ", tl->nacks);
+	}
+
+	fputc('}', out);
+}
+
+static int point_cmp(const void *a, const void *b)
+{
+	const struct point *pa = a;
+	const struct point *pb = b;
+
+	return pa->time < pb->time ? -1 : pa->time > pb->time;
+}
+
+/* Print the transfer, and a span up to each phase reached */
+static void print_timeline(FILE *out, const struct timeline *tl, uint64_t base)
+{
+	struct point points[TIMELINE_NR_PHASES + TIMELINE_ACKS];
+	unsigned int nacks = tl->nacks;
+	unsigned int n = 0;
+	unsigned int i;
+
+	for (i = TIMELINE_REQUEST + 1; i < TIMELINE_NR_PHASES; i++) {
+		if (tl->phases[i])
+			points[n++] = (struct point){ tl->phases[i], span_names[i], 0 };
+	}
+
+	if (nacks > TIMELINE_ACKS)
+		nacks = TIMELINE_ACKS;
+	for (i = 0; i < nacks; i++)
+		points[n++] = (struct point){ tl->acks[i], NULL, i + 1 };
+
+	qsort(points, n, sizeof(points[0]), point_cmp);
+
+	print_event(out, tl, NULL, 0, tl->phases[TIMELINE_REQUEST] - base,
+		    tl->phases[TIMELINE_CLOSED] - base);
+
+	for (i = 0; i < n; i++) {
+		print_event(out, tl, points[i].name, points[i].ack,
+			    (i ? points[i - 1].time : tl->phases[TIMELINE_REQUEST]) - base,
+			    points[i].time - base);
+	}
+}
+
+static void usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [<timeline file> [<json file>]]\n", progname);
+	fprintf(stderr, "Converts the timelines written by tqftpserv to the Chrome trace\n"
+			"event format, as loaded by Perfetto or chrome://tracing; each\n"
+			"remote node is shown as a process, each transfer as a thread\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = TIMELINE_PATH;
+	struct timeline_header hdr;
+	struct timeline *tls;
+	FILE *out = stdout;
+	uint64_t base = UINT64_MAX;
+	unsigned int i;
+	FILE *f;
+
+	if (argc > 3 || (argc > 1 && argv[1][0] == '-'))
+		usage(argv[0]);
+	if (argc > 1)
+		path = argv[1];
+
+	f = fopen(path, "re");
+	if (!f)
+		err(1, "failed to open %s", path);
+
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != TIMELINE_MAGIC)
+		errx(1, "%s is not a timeline file", path);
+	if (hdr.version != TIMELINE_VERSION ||
+	    hdr.record_size != sizeof(struct timeline))
+		errx(1, "%s is of an unsupported version %u", path, hdr.version);
+
+	tls = calloc(hdr.count, sizeof(*tls));
+	if (!tls && hdr.count)
+		err(1, "failed to allocate timelines");
+	if (fread(tls, sizeof(*tls), hdr.count, f) != hdr.count)
+		errx(1, "%s is truncated", path);
+	fclose(f);
+
+	if (argc > 2) {
+		out = fopen(argv[2], "we");
+		if (!out)
+			err(1, "failed to create %s", argv[2]);
+	}
+
+	for (i = 0; i < hdr.count; i++) {
+		tls[i].filename[TIMELINE_NAME_MAX - 1] = '\0';
+		if (tls[i].phases[TIMELINE_REQUEST] < base)
+			base = tls[i].phases[TIMELINE_REQUEST];
+	}
+
+	fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	for (i = 0; i < hdr.count; i++)
+		print_timeline(out, &tls[i], base);
+	fprintf(out, "\n]}\n");
+
+	free(tls);
+
+	if (fclose(out))
+		err(1, "failed to write trace");
+
+	return 0;
+}
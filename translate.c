@@ -2,6 +2,12 @@
 /*
  * Copyright (c) 2019, Linaro Ltd.
  */
+
+/* For asprintf */
+#define _GNU_SOURCE
+
+#include <sys/file.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <dirent.h>
@@ -10,12 +16,20 @@
 #include <fcntl.h>
 #include <libgen.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include "list.h"
+#include "logger.h"
+#include "logstore.h"
+#include "metrics.h"
+#include "probes.h"
+#include "profiler.h"
 #include "translate.h"
+#include "zstd-compress.h"
 #include "zstd-decompress.h"
 
 #define READONLY_PATH	"/readonly/firmware/image/"
@@ -29,8 +43,115 @@
 #define TQFTPSERV_TMP	"/data/vendor/tmp/tqftpserv"
 #endif
 
+/* linux-firmware uses .zst as file extension */
+#define ZSTD_EXTENSION ".zst"
+
 static int open_maybe_compressed(const char *path);
 
+static bool use_logstore;
+static bool use_compression;
+
+/* Where /readonly and /readwrite are found, see translate_set_roots() */
+static char firmware_base[PATH_MAX] = FIRMWARE_BASE;
+static char readwrite_base[PATH_MAX] = TQFTPSERV_TMP;
+static pthread_mutex_t roots_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void firmware_base_get(char *base)
+{
+	pthread_mutex_lock(&roots_lock);
+	strcpy(base, firmware_base);
+	pthread_mutex_unlock(&roots_lock);
+}
+
+/* Known location of a file under /readonly, see translate_index_firmware() */
+struct index_entry {
+	struct list_head node;
+
+	char *file;
+	char *fw_dir;
+	char *path;
+	bool ambiguous;
+};
+
+static struct list_head fw_index = LIST_INIT(fw_index);
+static pthread_mutex_t index_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct index_entry *index_find(const char *file)
+{
+	struct index_entry *entry;
+
+	list_for_each_entry(entry, &fw_index, node) {
+		if (!strcmp(entry->file, file))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/**
+ * index_add() - record where a file under /readonly was found
+ * @file:	file name, as requested by the client
+ * @fw_dir:	firmware directory the file was found in
+ * @path:	path of the file, without compression extension
+ *
+ * Return: true if the file was not indexed before
+ */
+static bool index_add(const char *file, const char *fw_dir, const char *path)
+{
+	struct index_entry *entry;
+	bool added = false;
+
+	pthread_mutex_lock(&index_lock);
+	entry = index_find(file);
+	if (!entry) {
+		entry = calloc(1, sizeof(*entry));
+		if (entry) {
+			entry->file = strdup(file);
+			entry->fw_dir = strdup(fw_dir);
+			entry->path = strdup(path);
+			list_add(&fw_index, &entry->node);
+			added = true;
+		}
+	} else if (strcmp(entry->fw_dir, fw_dir) && strcmp(entry->path, path)) {
+		/* Which one is picked depends on the remoteproc scan order */
+		entry->ambiguous = true;
+	}
+	pthread_mutex_unlock(&index_lock);
+
+	return added;
+}
+
+static char *index_lookup(const char *file)
+{
+	struct index_entry *entry;
+	char *path = NULL;
+
+	pthread_mutex_lock(&index_lock);
+	entry = index_find(file);
+	if (entry && !entry->ambiguous)
+		path = strdup(entry->path);
+	pthread_mutex_unlock(&index_lock);
+
+	return path;
+}
+
+/* Forget all known locations, such as when the firmware root changes */
+static void index_clear(void)
+{
+	struct index_entry *entry;
+	struct index_entry *next;
+
+	pthread_mutex_lock(&index_lock);
+	list_for_each_entry_safe(entry, next, &fw_index, node) {
+		list_del(&entry->node);
+		free(entry->file);
+		free(entry->fw_dir);
+		free(entry->path);
+		free(entry);
+	}
+	pthread_mutex_unlock(&index_lock);
+}
+
 static void read_fw_path_from_sysfs(char *outbuffer, size_t bufsize)
 {
 	size_t pathsize;
@@ -67,24 +188,38 @@ static int translate_readonly(const char *file)
 	char firmware_attr[32];
 	char path[PATH_MAX];
 	char fw_sysfs_path[PATH_MAX];
+	char fw_base[PATH_MAX];
 	struct dirent *de;
 	int firmware_fd;
 	DIR *class_dir;
 	int class_fd;
+	char *indexed_path;
 	ssize_t n;
 	int fd = -1;
 
+	/* Skip the scan when the file's location is already known */
+	indexed_path = index_lookup(file);
+	if (indexed_path) {
+		fd = open_maybe_compressed(indexed_path);
+		free(indexed_path);
+		/* Over the budget of decompressed copies, don't look further */
+		if (fd >= 0 || errno == EAGAIN)
+			return fd;
+	}
+
 	read_fw_path_from_sysfs(fw_sysfs_path, sizeof(fw_sysfs_path));
+	firmware_base_get(fw_base);
 
 	class_fd = open("/sys/class/remoteproc", O_RDONLY | O_DIRECTORY);
 	if (class_fd < 0) {
-		warn("failed to open remoteproc class");
+		pr_err("failed to open remoteproc class: %s", strerror(errno));
 		return -1;
 	}
 
 	class_dir = fdopendir(class_fd);
 	if (!class_dir) {
-		warn("failed to opendir");
+		pr_err("failed to opendir remoteproc class: %s",
+		       strerror(errno));
 		close(class_fd);
 		return -1;
 	}
@@ -122,29 +257,29 @@ static int translate_readonly(const char *file)
 			strcat(path, file);
 
 			fd = open_maybe_compressed(path);
-			if (fd >= 0)
+			if (fd >= 0 || errno == EAGAIN)
 				break;
 			if (errno != ENOENT)
-				warn("failed to open %s", path);
+				pr_warn("failed to open %s: %s", path, strerror(errno));
 		}
 
 		/* now try with base path */
-		if (strlen(FIRMWARE_BASE) + strlen(firmware_value) + 1 +
+		if (strlen(fw_base) + strlen(firmware_value) + 1 +
 		    strlen(file) + 1 > sizeof(path))
 			continue;
 
-		strcpy(path, FIRMWARE_BASE);
+		strcpy(path, fw_base);
 		strcat(path, firmware_path);
 		strcat(path, "/");
 		strcat(path, file);
 
 		fd = open_maybe_compressed(path);
 
-		if (fd >= 0)
+		if (fd >= 0 || errno == EAGAIN)
 			break;
 
 		if (errno != ENOENT)
-			warn("failed to open %s", path);
+			pr_warn("failed to open %s: %s", path, strerror(errno));
 	}
 
 	free(firmware_value_copy);
@@ -153,6 +288,212 @@ static int translate_readonly(const char *file)
 	return fd;
 }
 
+static void index_dir(const char *dir, const char *fw_dir,
+		      translate_index_cb_t cb, void *data)
+{
+	char file[NAME_MAX + 1];
+	char *request = NULL;
+	char *path = NULL;
+	struct dirent *de;
+	struct stat sb;
+	size_t len;
+	DIR *d;
+
+	d = opendir(dir);
+	if (!d)
+		return;
+
+	while ((de = readdir(d)) != NULL) {
+		if (de->d_type != DT_REG && de->d_type != DT_LNK)
+			continue;
+
+		if (fstatat(dirfd(d), de->d_name, &sb, 0) < 0 || !S_ISREG(sb.st_mode))
+			continue;
+
+		/* Compressed files are requested by their uncompressed name */
+		strcpy(file, de->d_name);
+		len = strlen(file);
+		if (len > strlen(ZSTD_EXTENSION) &&
+		    !strcmp(file + len - strlen(ZSTD_EXTENSION), ZSTD_EXTENSION))
+			file[len - strlen(ZSTD_EXTENSION)] = '\0';
+
+		if (asprintf(&path, "%s/%s", dir, file) < 0)
+			break;
+
+		if (index_add(file, fw_dir, path) && cb &&
+		    asprintf(&request, "%s%s", READONLY_PATH, file) >= 0) {
+			cb(request, sb.st_size, data);
+			free(request);
+		}
+
+		free(path);
+	}
+
+	closedir(d);
+}
+
+/**
+ * translate_index_firmware() - index the directory of a remoteproc firmware
+ * @firmware:	firmware of the remoteproc, relative to the firmware search path
+ * @cb:		called for each newly indexed file, may be NULL
+ * @data:	passed to @cb
+ *
+ * Lists the files residing next to @firmware, in the same locations as
+ * searched by translate_readonly(), and records where they were found so
+ * that requests for them don't need to scan all remoteprocs. @cb is passed
+ * the path the file would be requested by and its size.
+ */
+void translate_index_firmware(const char *firmware, translate_index_cb_t cb,
+			      void *data)
+{
+	char fw_sysfs_path[PATH_MAX] = "";
+	char fw_base[PATH_MAX];
+	char *firmware_copy;
+	char *fw_dir;
+	char *dir;
+
+	read_fw_path_from_sysfs(fw_sysfs_path, sizeof(fw_sysfs_path));
+	firmware_base_get(fw_base);
+
+	firmware_copy = strdup(firmware);
+	fw_dir = dirname(firmware_copy);
+
+	/* Same order as translate_readonly(), so the first match wins */
+	if (strlen(fw_sysfs_path) > 0 &&
+	    asprintf(&dir, "%s/%s", fw_sysfs_path, fw_dir) >= 0) {
+		index_dir(dir, fw_dir, cb, data);
+		free(dir);
+	}
+
+	if (asprintf(&dir, "%s%s", fw_base, fw_dir) >= 0) {
+		index_dir(dir, fw_dir, cb, data);
+		free(dir);
+	}
+
+	free(firmware_copy);
+}
+
+/**
+ * restore_compressed() - decompress a file compressed at rest back in place
+ * @base:	fd of the temporary directory
+ * @file:	relative path of the file, without compression extension
+ *
+ * Return: 0 on success, -1 otherwise
+ */
+static int restore_compressed(int base, const char *file)
+{
+	char *zst_file = NULL;
+	char *tmp_file = NULL;
+	char *zst_path = NULL;
+	struct stat sb;
+	off_t offset = 0;
+	ssize_t n;
+	int ret = -1;
+	int out;
+	int fd;
+
+	if (asprintf(&zst_file, "%s%s", file, ZSTD_EXTENSION) < 0 ||
+	    asprintf(&tmp_file, "%s.tmp", file) < 0 ||
+	    asprintf(&zst_path, "%s/%s", readwrite_base, zst_file) < 0)
+		goto out;
+
+	fd = zstd_decompress_file(zst_path);
+	if (fd < 0)
+		goto out;
+
+	out = openat(base, tmp_file, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (out < 0) {
+		close(fd);
+		goto out;
+	}
+
+	fstat(fd, &sb);
+	while (offset < sb.st_size) {
+		n = sendfile(out, fd, &offset, sb.st_size - offset);
+		if (n <= 0)
+			break;
+	}
+	close(fd);
+
+	if (offset != sb.st_size || fdatasync(out) < 0 ||
+	    renameat(base, tmp_file, base, file) < 0) {
+		close(out);
+		unlinkat(base, tmp_file, 0);
+		goto out;
+	}
+	close(out);
+
+	unlinkat(base, zst_file, 0);
+	ret = 0;
+
+out:
+	free(zst_file);
+	free(tmp_file);
+	free(zst_path);
+	return ret;
+}
+
+/**
+ * open_readwrite_compressed() - open "file" which might be compressed at rest
+ * @base:	fd of the temporary directory
+ * @file:	relative path of the requested file
+ * @flags:	flags to be passed to open(2)
+ *
+ * Readers of a file which has been compressed get a decompressed copy, while
+ * writers get the file decompressed back in place first. Writers hold a shared
+ * flock(2) on the file, which keeps the background compression away from it.
+ *
+ * Return: opened fd on success, -1 otherwise
+ */
+static int open_readwrite_compressed(int base, const char *file, int flags)
+{
+	char *zst_file = NULL;
+	char *zst_path = NULL;
+	struct stat sb;
+	int fd;
+
+	if (asprintf(&zst_file, "%s%s", file, ZSTD_EXTENSION) < 0)
+		return -1;
+
+	if ((flags & O_ACCMODE) == O_RDONLY) {
+		fd = openat(base, file, flags);
+		if (fd < 0 && errno == ENOENT &&
+		    !faccessat(base, zst_file, F_OK, 0) &&
+		    asprintf(&zst_path, "%s/%s", readwrite_base, zst_file) >= 0)
+			fd = zstd_decompress_file(zst_path);
+		goto out;
+	}
+
+	for (;;) {
+		if (faccessat(base, file, F_OK, 0) < 0 &&
+		    !faccessat(base, zst_file, F_OK, 0) &&
+		    restore_compressed(base, file) < 0) {
+			pr_err("failed to restore compressed %s", file);
+			fd = -1;
+			break;
+		}
+
+		fd = openat(base, file, flags, 0600);
+		if (fd < 0)
+			break;
+
+		flock(fd, LOCK_SH);
+
+		/* Lost the race against compression, try again */
+		if (!fstat(fd, &sb) && !sb.st_nlink) {
+			close(fd);
+			continue;
+		}
+
+		break;
+	}
+
+out:
+	free(zst_file);
+	free(zst_path);
+	return fd;
+}
+
 /**
  * translate_readwrite() - open "file" from a temporary directory
  * @file:	relative path of the requested file, with /readwrite/ stripped
@@ -166,22 +507,35 @@ static int translate_readwrite(const char *file, int flags)
 	int ret;
 	int fd;
 
-	ret = mkdir(TQFTPSERV_TMP, 0700);
+	if (use_logstore) {
+		fd = logstore_open(file, flags);
+		if (fd < 0 && errno != ENOENT)
+			pr_warn("failed to open %s: %s", file, strerror(errno));
+		return fd;
+	}
+
+	ret = mkdir(readwrite_base, 0700);
 	if (ret < 0 && errno != EEXIST) {
-		warn("failed to create temporary tqftpserv directory");
+		pr_err("failed to create temporary tqftpserv directory: %s",
+		       strerror(errno));
 		return -1;
 	}
 
-	base = open(TQFTPSERV_TMP, O_RDONLY | O_DIRECTORY);
+	base = open(readwrite_base, O_RDONLY | O_DIRECTORY);
 	if (base < 0) {
-		warn("failed top open temporary tqftpserv directory");
+		pr_err("failed to open temporary tqftpserv directory: %s",
+		       strerror(errno));
 		return -1;
 	}
 
-	fd = openat(base, file, flags, 0600);
+	if (use_compression)
+		fd = open_readwrite_compressed(base, file, flags);
+	else
+		fd = openat(base, file, flags, 0600);
 	close(base);
-	if (fd < 0)
-		warn("failed to open %s", file);
+	/* Missing files are for the remote to deal with */
+	if (fd < 0 && errno != ENOENT && errno != EAGAIN)
+		pr_warn("failed to open %s: %s", file, strerror(errno));
 
 	return fd;
 }
@@ -196,18 +550,193 @@ static int translate_readwrite(const char *file, int flags)
  */
 int translate_open(const char *path, int flags)
 {
-	if (!strncmp(path, READONLY_PATH, strlen(READONLY_PATH)))
-		return translate_readonly(path + strlen(READONLY_PATH));
-	else if (!strncmp(path, READWRITE_PATH, strlen(READWRITE_PATH)))
-		return translate_readwrite(path + strlen(READWRITE_PATH), flags);
+	struct profiler_span span;
+	struct timespec start;
+	uint64_t us;
+	int fd;
+
+	TQFTP_PROBE1(translate__open__start, path);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	profiler_begin(&span);
+
+	if (!strncmp(path, READONLY_PATH, strlen(READONLY_PATH))) {
+		fd = translate_readonly(path + strlen(READONLY_PATH));
+	} else if (!strncmp(path, READWRITE_PATH, strlen(READWRITE_PATH))) {
+		fd = translate_readwrite(path + strlen(READWRITE_PATH), flags);
+	} else {
+		pr_warn("invalid path %s, rejecting", path);
+		errno = ENOENT;
+		return -1;
+	}
 
-	fprintf(stderr, "invalid path %s, rejecting\n", path);
-	errno = ENOENT;
-	return -1;
+	profiler_end(&span, PROFILER_RESOLVE, NULL, -1, 0);
+	us = metrics_time(METRICS_RESOLVE, &start);
+	TQFTP_PROBE3(translate__open__end, path, fd, us);
+
+	return fd;
 }
 
-/* linux-firmware uses .zst as file extension */
-#define ZSTD_EXTENSION ".zst"
+/**
+ * translate_cacheable() - check if the file behind @path may be cached
+ * @path:	path, as requested by the remote
+ *
+ * Files under /readonly are not expected to change while we're running, so
+ * once resolved they can be kept around.
+ */
+bool translate_cacheable(const char *path)
+{
+	return !strncmp(path, READONLY_PATH, strlen(READONLY_PATH));
+}
+
+/**
+ * translate_close() - close fd returned by translate_open()
+ * @fd:		fd to close
+ *
+ * Files written through the log-structured store are queued to be committed
+ * here, the store closing them once committed.
+ */
+void translate_close(int fd)
+{
+	if (use_logstore && logstore_release(fd))
+		return;
+
+	close(fd);
+}
+
+/**
+ * translate_sync() - wait for files closed by translate_close() to be stored
+ */
+void translate_sync(void)
+{
+	if (use_logstore)
+		logstore_sync();
+}
+
+/**
+ * translate_adopt() - take over a file opened by translate_open() in another process
+ * @path:	path, as requested by the remote
+ * @fd:		fd returned by translate_open() in the other process
+ *
+ * Used when taking over transfers from a running process, so that
+ * translate_close() treats @fd as if opened here.
+ */
+void translate_adopt(const char *path, int fd)
+{
+	if (use_logstore && !strncmp(path, READWRITE_PATH, strlen(READWRITE_PATH)))
+		logstore_adopt(fd, path + strlen(READWRITE_PATH));
+}
+
+/**
+ * translate_set_roots() - set the directories /readonly and /readwrite map to
+ * @firmware:	firmware directory searched for /readonly files, NULL or empty
+ *		to leave unchanged
+ * @readwrite:	directory holding /readwrite files, NULL or empty to leave
+ *		unchanged
+ *
+ * The firmware directory may change at any time. The /readwrite directory
+ * can't change once the log-structured store or compression at rest use it.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int translate_set_roots(const char *firmware, const char *readwrite)
+{
+	char base[PATH_MAX];
+	bool changed;
+
+	if (readwrite && *readwrite && strcmp(readwrite, readwrite_base)) {
+		if (use_logstore || use_compression) {
+			warnx("/readwrite directory in use, not changing it");
+			return -1;
+		}
+
+		if (strlen(readwrite) >= sizeof(readwrite_base))
+			return -1;
+		strcpy(readwrite_base, readwrite);
+	}
+
+	if (!firmware || !*firmware)
+		return 0;
+
+	/* Stored with a trailing slash, paths are appended to it as is */
+	if (snprintf(base, sizeof(base), "%s%s", firmware,
+		     firmware[strlen(firmware) - 1] == '/' ? "" : "/") >= sizeof(base))
+		return -1;
+
+	pthread_mutex_lock(&roots_lock);
+	changed = strcmp(firmware_base, base);
+	strcpy(firmware_base, base);
+	pthread_mutex_unlock(&roots_lock);
+
+	if (changed)
+		index_clear();
+
+	return 0;
+}
+
+/**
+ * translate_use_logstore() - back /readwrite with a log-structured store
+ *
+ * Rather than creating one file per /readwrite entry, keep all of them in a
+ * single append-only log in the temporary directory.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int translate_use_logstore(void)
+{
+	int ret;
+
+	if (use_compression) {
+		warnx("log-structured store not supported with compression at rest");
+		return -1;
+	}
+
+	ret = mkdir(readwrite_base, 0700);
+	if (ret < 0 && errno != EEXIST) {
+		warn("failed to create temporary tqftpserv directory");
+		return -1;
+	}
+
+	ret = logstore_init(readwrite_base);
+	if (ret < 0)
+		return -1;
+
+	use_logstore = true;
+
+	return 0;
+}
+
+/**
+ * translate_compress_readwrite() - compress cold /readwrite files at rest
+ *
+ * Large files written by the remote, such as logs and dumps, are typically
+ * written once and rarely read back. Compress these in the background once
+ * they have gone cold, they are transparently decompressed when requested.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int translate_compress_readwrite(void)
+{
+	int ret;
+
+	if (use_logstore) {
+		warnx("compression at rest not supported with log-structured store");
+		return -1;
+	}
+
+	ret = mkdir(readwrite_base, 0700);
+	if (ret < 0 && errno != EEXIST) {
+		warn("failed to create temporary tqftpserv directory");
+		return -1;
+	}
+
+	ret = zstd_compress_start(readwrite_base);
+	if (ret < 0)
+		return -1;
+
+	use_compression = true;
+
+	return 0;
+}
 
 /**
  * open_maybe_compressed() - open a file and maybe decompress it if necessary
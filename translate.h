@@ -1,6 +1,20 @@
 #ifndef __TRANSLATE_H__
 #define __TRANSLATE_H__
 
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef void (*translate_index_cb_t)(const char *path, size_t size, void *data);
+
 int translate_open(const char *path, int flags);
+void translate_close(int fd);
+void translate_sync(void);
+void translate_adopt(const char *path, int fd);
+bool translate_cacheable(const char *path);
+void translate_index_firmware(const char *firmware, translate_index_cb_t cb,
+			      void *data);
+int translate_set_roots(const char *firmware, const char *readwrite);
+int translate_use_logstore(void);
+int translate_compress_readwrite(void);
 
 #endif
@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+/* For sync_file_range */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "list.h"
+#include "writeback.h"
+
+/* A range written back by the main loop, to be waited for and dropped */
+struct writeback_range {
+	struct list_head node;
+
+	int fd;
+	off_t offset;
+	size_t len;
+};
+
+static struct list_head ranges = LIST_INIT(ranges);
+static pthread_mutex_t writeback_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writeback_cond = PTHREAD_COND_INITIALIZER;
+static bool writeback_running;
+
+static void *writeback_thread(void *data)
+{
+	struct writeback_range *range;
+
+	for (;;) {
+		pthread_mutex_lock(&writeback_lock);
+		while (list_empty(&ranges))
+			pthread_cond_wait(&writeback_cond, &writeback_lock);
+
+		range = list_entry_first(&ranges, struct writeback_range, node);
+		list_del(&range->node);
+		pthread_mutex_unlock(&writeback_lock);
+
+		sync_file_range(range->fd, range->offset, range->len,
+				SYNC_FILE_RANGE_WAIT_BEFORE |
+				SYNC_FILE_RANGE_WRITE |
+				SYNC_FILE_RANGE_WAIT_AFTER);
+		posix_fadvise(range->fd, range->offset, range->len,
+			      POSIX_FADV_DONTNEED);
+
+		close(range->fd);
+		free(range);
+	}
+
+	return NULL;
+}
+
+/**
+ * writeback_init() - start the thread waiting for written back ranges
+ *
+ * Return: 0 on success, -1 on error
+ */
+int writeback_init(void)
+{
+	pthread_t thread;
+	sigset_t mask;
+	sigset_t old;
+	int ret;
+
+	if (writeback_running)
+		return 0;
+
+	/* Leave signals to the main loop */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, &old);
+	ret = pthread_create(&thread, NULL, writeback_thread, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (ret) {
+		errno = ret;
+		return -1;
+	}
+	pthread_detach(thread);
+
+	writeback_running = true;
+
+	return 0;
+}
+
+/**
+ * writeback_start() - start writeback of a range of a file
+ * @fd:		file written to
+ * @offset:	offset of the range
+ * @len:	length of the range
+ *
+ * Only starts the writeback, without waiting for any of it.
+ *
+ * Return: 0 on success, -1 if @fd doesn't support writeback
+ */
+int writeback_start(int fd, off_t offset, size_t len)
+{
+	return sync_file_range(fd, offset, len, SYNC_FILE_RANGE_WRITE);
+}
+
+/**
+ * writeback_drop() - wait for a range to be written back, then drop it
+ * @fd:		file written to
+ * @offset:	offset of the range, passed to writeback_start() before
+ * @len:	length of the range
+ *
+ * The range is dropped from the page cache once on disk, from the writeback
+ * thread so that the caller doesn't wait on the disk. Without the thread, the
+ * range is left to the kernel's own writeback.
+ */
+void writeback_drop(int fd, off_t offset, size_t len)
+{
+	struct writeback_range *range;
+
+	if (!writeback_running)
+		return;
+
+	range = calloc(1, sizeof(*range));
+	if (!range)
+		return;
+
+	/* The caller may close its fd while the range is waited for */
+	range->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if (range->fd < 0) {
+		free(range);
+		return;
+	}
+	range->offset = offset;
+	range->len = len;
+
+	pthread_mutex_lock(&writeback_lock);
+	list_add(&ranges, &range->node);
+	pthread_cond_signal(&writeback_cond);
+	pthread_mutex_unlock(&writeback_lock);
+}
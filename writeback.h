@@ -0,0 +1,15 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __WRITEBACK_H__
+#define __WRITEBACK_H__
+
+#include <sys/types.h>
+
+int writeback_init(void);
+int writeback_start(int fd, off_t offset, size_t len);
+void writeback_drop(int fd, off_t offset, size_t len);
+
+#endif
@@ -0,0 +1,284 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+/* For syscall() and renameat() */
+#define _GNU_SOURCE
+
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <zstd.h>
+
+#include "list.h"
+#include "zstd-compress.h"
+
+/* How often to look for cold files, in seconds */
+#define COMPRESS_INTERVAL	60
+/* Files not modified for this long, in seconds, are considered cold */
+#define COMPRESS_COLD_AGE	600
+/* Not worth the trouble for small files */
+#define COMPRESS_MIN_SIZE	(64 * 1024)
+
+#define ZSTD_EXTENSION		".zst"
+#define TMP_EXTENSION		".tmp"
+
+#define IOPRIO_CLASS_SHIFT	13
+#define IOPRIO_CLASS_IDLE	3
+#define IOPRIO_WHO_PROCESS	1
+
+/* Files found not to shrink, so they are not compressed over and over */
+struct incompressible {
+	struct list_head node;
+
+	dev_t dev;
+	ino_t ino;
+	struct timespec mtime;
+};
+
+static struct list_head incompressibles = LIST_INIT(incompressibles);
+
+static ZSTD_CCtx *zstd_context;
+static char *compress_dir;
+
+static bool is_incompressible(const struct stat *sb)
+{
+	struct incompressible *inc;
+
+	list_for_each_entry(inc, &incompressibles, node) {
+		if (inc->dev == sb->st_dev && inc->ino == sb->st_ino &&
+		    inc->mtime.tv_sec == sb->st_mtim.tv_sec &&
+		    inc->mtime.tv_nsec == sb->st_mtim.tv_nsec)
+			return true;
+	}
+
+	return false;
+}
+
+static void mark_incompressible(const struct stat *sb)
+{
+	struct incompressible *inc;
+
+	inc = calloc(1, sizeof(*inc));
+	if (!inc)
+		return;
+
+	inc->dev = sb->st_dev;
+	inc->ino = sb->st_ino;
+	inc->mtime = sb->st_mtim;
+	list_add(&incompressibles, &inc->node);
+}
+
+static bool has_suffix(const char *name, const char *suffix)
+{
+	size_t len = strlen(name);
+	size_t slen = strlen(suffix);
+
+	return len >= slen && !strcmp(name + len - slen, suffix);
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t n;
+
+	while (len) {
+		n = write(fd, p, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/**
+ * compress_file() - replace a cold file with a zstd-compressed copy
+ * @dir_fd:	directory holding the file
+ * @name:	name of the file
+ *
+ * Writers take a shared flock(2) on the files they open, so an exclusive lock
+ * is held throughout to make sure nobody is writing to the file while it is
+ * being compressed and unlinked.
+ */
+static void compress_file(int dir_fd, const char *name)
+{
+	char zst_name[NAME_MAX + 1];
+	char tmp_name[NAME_MAX + 1];
+	void *compressed = NULL;
+	void *data = MAP_FAILED;
+	struct stat sb;
+	size_t bound;
+	size_t len;
+	int out_fd;
+	int fd;
+
+	if (snprintf(zst_name, sizeof(zst_name), "%s%s", name, ZSTD_EXTENSION) >= sizeof(zst_name) ||
+	    snprintf(tmp_name, sizeof(tmp_name), "%s%s", zst_name, TMP_EXTENSION) >= sizeof(tmp_name))
+		return;
+
+	fd = openat(dir_fd, name, O_RDONLY | O_NOFOLLOW);
+	if (fd < 0)
+		return;
+
+	if (flock(fd, LOCK_EX | LOCK_NB) < 0)
+		goto out;
+
+	if (fstat(fd, &sb) < 0 || !S_ISREG(sb.st_mode) || !sb.st_nlink ||
+	    sb.st_size < COMPRESS_MIN_SIZE ||
+	    time(NULL) - sb.st_mtime < COMPRESS_COLD_AGE ||
+	    is_incompressible(&sb))
+		goto out;
+
+	data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+		goto out;
+
+	bound = ZSTD_compressBound(sb.st_size);
+	compressed = malloc(bound);
+	if (!compressed)
+		goto out;
+
+	len = ZSTD_compressCCtx(zstd_context, compressed, bound, data,
+				sb.st_size, ZSTD_CLEVEL_DEFAULT);
+	if (ZSTD_isError(len)) {
+		warnx("failed to compress %s: %s", name, ZSTD_getErrorName(len));
+		goto out;
+	}
+
+	/* Keep files which barely shrink as they are */
+	if (len > sb.st_size - sb.st_size / 8) {
+		mark_incompressible(&sb);
+		goto out;
+	}
+
+	out_fd = openat(dir_fd, tmp_name, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (out_fd < 0) {
+		warn("failed to create %s", tmp_name);
+		goto out;
+	}
+
+	if (write_all(out_fd, compressed, len) < 0 || fdatasync(out_fd) < 0 ||
+	    renameat(dir_fd, tmp_name, dir_fd, zst_name) < 0) {
+		warn("failed to write %s", zst_name);
+		close(out_fd);
+		unlinkat(dir_fd, tmp_name, 0);
+		goto out;
+	}
+	close(out_fd);
+
+	unlinkat(dir_fd, name, 0);
+	fsync(dir_fd);
+
+out:
+	free(compressed);
+	if (data != MAP_FAILED)
+		munmap(data, sb.st_size);
+	close(fd);
+}
+
+static void compress_dir_walk(int dir_fd)
+{
+	struct dirent *de;
+	DIR *dir;
+	int fd;
+
+	dir = fdopendir(dir_fd);
+	if (!dir) {
+		close(dir_fd);
+		return;
+	}
+
+	while ((de = readdir(dir)) != NULL) {
+		if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+			continue;
+
+		if (de->d_type == DT_DIR) {
+			fd = openat(dir_fd, de->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+			if (fd >= 0)
+				compress_dir_walk(fd);
+			continue;
+		}
+
+		if (de->d_type != DT_REG ||
+		    has_suffix(de->d_name, ZSTD_EXTENSION) ||
+		    has_suffix(de->d_name, TMP_EXTENSION))
+			continue;
+
+		compress_file(dir_fd, de->d_name);
+	}
+
+	closedir(dir);
+}
+
+static void *compress_thread(void *data)
+{
+	int fd;
+
+	/* Stay out of the way of the transfers, both on the CPU and the disk */
+	setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+	syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+		IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+
+	for (;;) {
+		sleep(COMPRESS_INTERVAL);
+
+		fd = open(compress_dir, O_RDONLY | O_DIRECTORY);
+		if (fd < 0)
+			continue;
+
+		compress_dir_walk(fd);
+	}
+
+	return NULL;
+}
+
+/**
+ * zstd_compress_start() - start compressing cold files in the background
+ * @dir:	directory to look for cold files in
+ *
+ * Files under @dir which have not been modified for a while are replaced by
+ * a zstd-compressed copy, with the ".zst" extension appended, from a low
+ * priority thread.
+ *
+ * Return: 0 on success, -1 on error
+ */
+int zstd_compress_start(const char *dir)
+{
+	pthread_t thread;
+	int ret;
+
+	zstd_context = ZSTD_createCCtx();
+	if (!zstd_context)
+		return -1;
+
+	compress_dir = strdup(dir);
+
+	ret = pthread_create(&thread, NULL, compress_thread, NULL);
+	if (ret) {
+		errno = ret;
+		return -1;
+	}
+	pthread_detach(thread);
+
+	return 0;
+}
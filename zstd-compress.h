@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Copyright (c) 2026, Linaro Ltd.
+ */
+
+#ifndef __ZSTD_COMPRESS_H__
+#define __ZSTD_COMPRESS_H__
+
+#include "profile.h"
+
+#if TQFTP_WITH_ZSTD
+int zstd_compress_start(const char *dir);
+#else
+static inline int zstd_compress_start(const char *dir) { return -1; }
+#endif
+
+#endif
@@ -8,23 +8,69 @@
 
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <zstd.h>
 
+#include "logger.h"
+#include "membudget.h"
+#include "metrics.h"
+#include "probes.h"
+#include "profiler.h"
+#include "timeline.h"
 #include "zstd-decompress.h"
 
 static ZSTD_DCtx *zstd_context = NULL;
+/* Decompression may be requested from the prefetch thread */
+static pthread_mutex_t zstd_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Decompressed files at least this large are backed by huge pages, if enabled */
+#define HUGEPAGE_MIN_SIZE	(2 * 1024 * 1024)
+
+static bool zstd_hugepages;
+
+/* Asked for the size of each file this thread is about to decompress */
+static __thread zstd_charge_fn attached_charge;
+
+/*
+ * Set up state for decompression on first use, rather than on startup, as
+ * many boots don't decompress anything. Called with zstd_lock held.
+ */
+static int zstd_init(void)
+{
+	if (!zstd_context)
+		zstd_context = ZSTD_createDCtx();
+
+	return zstd_context ? 0 : -1;
+}
 
 /**
- * zstd_init() - set up state for decompression. Needs to be called before zstd_decompress_file()
+ * zstd_use_hugepages() - back large decompressed files by transparent huge pages
+ *
+ * This saves page faults while large images are decompressed into their
+ * memfd, at the cost of up to a huge page of memory per file. Transfers then
+ * pread() the memfd rather than map it, so there are no TLB misses of ours
+ * to save; the huge pages only leave fewer, larger, pages in the memfd.
+ */
+void zstd_use_hugepages(void)
+{
+	zstd_hugepages = true;
+}
+
+/**
+ * zstd_attach_charge() - check files decompressed by this thread against a budget
+ * @charge:	called with the decompressed size of each file before it's
+ *		decompressed, failing the decompression with EAGAIN if it returns
+ *		an error; NULL to stop
  */
-void zstd_init()
+void zstd_attach_charge(zstd_charge_fn charge)
 {
-	zstd_context = ZSTD_createDCtx();
+	attached_charge = charge;
 }
 
 /**
@@ -43,10 +89,20 @@ void zstd_free()
  */
 int zstd_decompress_file(const char *filename)
 {
+	TQFTP_PROBE1(decompress__start, filename);
+
+	struct profiler_span span;
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	profiler_begin(&span);
+	timeline_mark(TIMELINE_RESOLVED);
+
 	/* Figure out the size of the file. */
 	struct stat file_stat;
 	if (stat(filename, &file_stat) == -1) {
-		perror("stat failed");
+		/* Most files aren't compressed, this is how callers find out */
+		if (errno != ENOENT)
+			pr_err("failed to stat %s: %s", filename, strerror(errno));
 		return -1;
 	}
 
@@ -54,13 +110,13 @@ int zstd_decompress_file(const char *filename)
 
 	const int input_file_fd = open(filename, 0);
 	if (input_file_fd == -1) {
-		perror("open failed");
+		pr_err("failed to open %s: %s", filename, strerror(errno));
 		return -1;
 	}
 
 	void* const compressed_buffer = mmap(NULL, file_size, PROT_READ, MAP_POPULATE | MAP_PRIVATE, input_file_fd, 0);
 	if (compressed_buffer == MAP_FAILED) {
-		perror("mmap failed");
+		pr_err("failed to map %s: %s", filename, strerror(errno));
 		close(input_file_fd);
 		return -1;
 	}
@@ -68,37 +124,82 @@ int zstd_decompress_file(const char *filename)
 
 	const unsigned long long decompressed_size = ZSTD_getFrameContentSize(compressed_buffer, file_size);
 	if (decompressed_size == ZSTD_CONTENTSIZE_UNKNOWN) {
-		fprintf(stderr, "Content size could not be determined for %s\n", filename);
+		pr_err("Content size could not be determined for %s", filename);
+		munmap(compressed_buffer, file_size);
 		return -1;
 	}
 	if (decompressed_size == ZSTD_CONTENTSIZE_ERROR) {
-		fprintf(stderr, "Error getting content size for %s\n", filename);
+		pr_err("Error getting content size for %s", filename);
+		munmap(compressed_buffer, file_size);
 		return -1;
 	}
 
-	void* const decompressed_buffer = malloc((size_t)decompressed_size);
-	if (decompressed_buffer == NULL) {
-		perror("malloc failed");
-		return -1;
-	}
-
-	const size_t return_size = ZSTD_decompressDCtx(zstd_context, decompressed_buffer, decompressed_size, compressed_buffer, file_size);
-	if (ZSTD_isError(return_size)) {
-		fprintf(stderr, "ZSTD_decompress failed: %s\n", ZSTD_getErrorName(return_size));
+	if (attached_charge && attached_charge(decompressed_size) < 0) {
+		munmap(compressed_buffer, file_size);
+		errno = EAGAIN;
 		return -1;
 	}
 
 	const int output_file_fd = memfd_create(filename, 0);
 	if (output_file_fd == -1) {
-		perror("memfd_create failed");
+		pr_err("failed to create memfd for %s: %s", filename, strerror(errno));
+		munmap(compressed_buffer, file_size);
 		return -1;
 	}
 
-	if (write(output_file_fd, decompressed_buffer, decompressed_size) != decompressed_size) {
-		perror("write failed");
+	if (ftruncate(output_file_fd, decompressed_size) < 0) {
+		pr_err("failed to size memfd for %s: %s", filename, strerror(errno));
+		goto err_close;
+	}
+
+	if (!decompressed_size) {
+		munmap(compressed_buffer, file_size);
+		return output_file_fd;
+	}
+
+	/* Decompress straight into the memfd, rather than via a bounce buffer */
+	void* const decompressed_buffer = mmap(NULL, decompressed_size, PROT_READ | PROT_WRITE, MAP_SHARED, output_file_fd, 0);
+	if (decompressed_buffer == MAP_FAILED) {
+		pr_err("failed to map memfd for %s: %s", filename, strerror(errno));
+		goto err_close;
+	}
+
+	/*
+	 * Back large images by transparent huge pages, when shmem THP is set to
+	 * "advise" or "always"; the pages are allocated as they're written below,
+	 * a fault per huge page rather than per page. The mapping is gone once
+	 * decompressed. Failure just leaves them backed by regular pages.
+	 */
+	if (zstd_hugepages && decompressed_size >= HUGEPAGE_MIN_SIZE)
+		madvise(decompressed_buffer, decompressed_size, MADV_HUGEPAGE);
+
+	membudget_account(MEMBUDGET_DECOMPRESS, decompressed_size);
+
+	pthread_mutex_lock(&zstd_lock);
+	size_t return_size = (size_t)-1;
+	if (zstd_init() == 0)
+		return_size = ZSTD_decompressDCtx(zstd_context, decompressed_buffer, decompressed_size, compressed_buffer, file_size);
+	pthread_mutex_unlock(&zstd_lock);
+
+	munmap(decompressed_buffer, decompressed_size);
+	munmap(compressed_buffer, file_size);
+	membudget_account(MEMBUDGET_DECOMPRESS, -(ssize_t)decompressed_size);
+
+	if (ZSTD_isError(return_size)) {
+		pr_err("ZSTD_decompress failed: %s", ZSTD_getErrorName(return_size));
 		close(output_file_fd);
 		return -1;
 	}
 
+	profiler_end(&span, PROFILER_DECOMPRESS, NULL, -1, decompressed_size);
+	const uint64_t us = metrics_time(METRICS_DECOMPRESS, &start);
+	timeline_mark(TIMELINE_DECOMPRESSED);
+	TQFTP_PROBE3(decompress__end, filename, decompressed_size, us);
+
 	return output_file_fd;
+
+err_close:
+	close(output_file_fd);
+	munmap(compressed_buffer, file_size);
+	return -1;
 }
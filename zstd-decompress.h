@@ -7,9 +7,28 @@
 #define __ZSTD_DECOMPRESS_H__
 
 #include <stdbool.h>
+#include <stddef.h>
 
-void zstd_init();
+#include "profile.h"
+
+typedef int (*zstd_charge_fn)(size_t bytes);
+
+#if TQFTP_WITH_ZSTD
+void zstd_use_hugepages(void);
+void zstd_attach_charge(zstd_charge_fn charge);
 void zstd_free();
 int zstd_decompress_file(const char *filename);
+#else
+#include <errno.h>
+
+static inline void zstd_use_hugepages(void) {}
+static inline void zstd_attach_charge(zstd_charge_fn charge) {}
+static inline void zstd_free(void) {}
+static inline int zstd_decompress_file(const char *filename)
+{
+	errno = ENOENT;
+	return -1;
+}
+#endif
 
 #endif